@@ -0,0 +1,61 @@
+#include "CArena.h"
+
+#include <algorithm>
+
+// Every allocation is aligned on this.
+constexpr std::size_t ARENA_ALIGNMENT = 16;
+
+////////////////////////////////////////////////////////////////////////////
+CArena::CArena(const std::size_t inBlockSizeInByte)
+: m_blockSize(std::max(inBlockSizeInByte, ARENA_ALIGNMENT))
+, m_usedInLastBlock(0)
+, m_allocatedSize(0)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+uint8_t* CArena::allocate(const std::size_t inSizeInByte)
+{
+  uint8_t *pData = nullptr;
+  const std::size_t size = (std::max<std::size_t>(inSizeInByte, 1) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+
+  if (size > m_blockSize)
+  {
+    // large data gets its own block, in front so the last block stays the
+    // current one
+    m_blocks.insert(m_blocks.begin(), SBlock{std::unique_ptr<uint8_t[]>(new uint8_t[size]()), size});
+    m_allocatedSize += size;
+    if (m_blocks.size() == 1)
+    {
+      m_usedInLastBlock = size;
+    }
+    pData = m_blocks.front().m_pData.get();
+  }
+  else
+  {
+    if (m_blocks.empty() || m_usedInLastBlock + size > m_blocks.back().m_size)
+    {
+      m_blocks.push_back(SBlock{std::unique_ptr<uint8_t[]>(new uint8_t[m_blockSize]()), m_blockSize});
+      m_allocatedSize += m_blockSize;
+      m_usedInLastBlock = 0;
+    }
+    pData = m_blocks.back().m_pData.get() + m_usedInLastBlock;
+    m_usedInLastBlock += size;
+  }
+
+  return pData;
+} // allocate
+
+////////////////////////////////////////////////////////////////////////////
+void CArena::clear()
+{
+  m_blocks.clear();
+  m_usedInLastBlock = 0;
+  m_allocatedSize = 0;
+} // clear
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CArena::get_allocated_size() const
+{
+  return m_allocatedSize;
+} // get_allocated_size
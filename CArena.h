@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Monotonic allocator for chunk data: allocations are carved from large
+// blocks and only released all together.
+class CArena
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    explicit CArena(const std::size_t inBlockSizeInByte = 1 << 16);
+
+    ////////////////////////////////////////////////////////////////////////////
+    CArena(const CArena&) = delete;
+    CArena& operator=(const CArena&) = delete;
+    CArena(CArena&&) = default;
+    CArena& operator=(CArena&&) = default;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Zero-filled, never nullptr even for a 0 size.
+    uint8_t* allocate(const std::size_t inSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Release every allocation.
+    void clear();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Sum of the block sizes.
+    std::size_t get_allocated_size() const;
+
+  private:
+    struct SBlock
+    {
+      std::unique_ptr<uint8_t[]> m_pData;
+      std::size_t                m_size;
+    };
+
+    std::size_t         m_blockSize;
+    std::vector<SBlock> m_blocks;
+    std::size_t         m_usedInLastBlock;
+    std::size_t         m_allocatedSize;
+}; // class CArena
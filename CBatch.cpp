@@ -0,0 +1,374 @@
+#include "CBatch.h"
+#include "CPNG.h"
+#include "CThreadPool.h"
+#include "CMemoryBudget.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <glob.h>
+
+////////////////////////////////////////////////////////////////////////////
+CBatch::CBatch(const SBatchOptions& inOptions)
+: m_options(inOptions)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CBatch::add_input(const std::string& inInput)
+{
+  const std::size_t nbFiles = m_files.size();
+  std::error_code error;
+
+  if (!inInput.empty() && inInput[0] == '@')
+  {
+    const std::string manifestName = inInput.substr(1);
+    std::ifstream manifestFile;
+    if (manifestName != "-")
+    {
+      manifestFile.open(manifestName);
+    }
+    std::istream& manifest = (manifestName == "-")? std::cin : manifestFile;
+    if (manifest)
+    {
+      std::string line;
+      while (std::getline(manifest, line))
+      {
+        if (!line.empty() && line.back() == '\r')
+        {
+          line.pop_back();
+        }
+        if (!line.empty())
+        {
+          m_files.push_back(line);
+        }
+      }
+    }
+    else
+    {
+      std::cerr<<"Cannot read manifest '"<<manifestName<<"'"<<std::endl;
+    }
+  }
+  else if (std::filesystem::is_directory(inInput, error))
+  {
+    std::vector<std::string> dirFiles;
+    for (const auto& entry:std::filesystem::recursive_directory_iterator(inInput, error))
+    {
+      std::string extension = entry.path().extension().string();
+      std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+      if (entry.is_regular_file(error) && extension == ".png" && !is_output_name(entry.path().string()))
+      {
+        dirFiles.push_back(entry.path().string());
+      }
+    }
+    // deterministic order whatever the directory layout
+    std::sort(dirFiles.begin(), dirFiles.end());
+    m_files.insert(m_files.end(), dirFiles.begin(), dirFiles.end());
+  }
+  else if (inInput.find_first_of("*?[") != std::string::npos)
+  {
+    glob_t globResult;
+    if (glob(inInput.c_str(), 0, nullptr, &globResult) == 0)
+    {
+      for (std::size_t i = 0; i < globResult.gl_pathc; i++)
+      {
+        m_files.push_back(globResult.gl_pathv[i]);
+      }
+    }
+    globfree(&globResult);
+  }
+  else
+  {
+    m_files.push_back(inInput);
+  }
+
+  return m_files.size() - nbFiles;
+} // add_input
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CBatch::get_nb_files() const
+{
+  return m_files.size();
+} // get_nb_files
+
+////////////////////////////////////////////////////////////////////////////
+bool CBatch::run(std::ostream& ioStream)
+{
+  const auto startTime = std::chrono::steady_clock::now();
+
+  CThreadPool pool(m_options.m_nbThreads);
+  CMemoryBudget budget(m_options.m_maxInFlightBytes);
+  // a hard cap: files over it fail instead of waiting
+  std::unique_ptr<CMemoryBudget> pProcessBudget;
+  if (m_options.m_maxProcessBytes > 0)
+  {
+    pProcessBudget.reset(new CMemoryBudget(m_options.m_maxProcessBytes));
+  }
+  const SMemoryLimits limits = {m_options.m_maxChunkSize, m_options.m_maxFileSize, pProcessBudget.get()};
+  std::mutex outputMutex;
+  std::condition_variable doneCondition;
+  std::size_t nbDone = 0;
+  std::size_t nbOk = 0;
+  std::size_t totalSize = 0;
+
+  // after the pool: its completions hand the work over to the pool
+  std::unique_ptr<CIOEngine> pEngine;
+  if (m_options.m_isAsyncIO && !m_options.m_isInPlace)
+  {
+    pEngine = CIOEngine::create(m_options.m_ioBackend, m_options.m_ioQueueDepth);
+  }
+
+  const auto finish_file = [&](const std::string& inFile, const std::size_t inCharge, const SFileResult& inResult,
+                               const std::chrono::steady_clock::time_point inFileStart)
+                           {
+                             budget.release(inCharge);
+                             const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - inFileStart;
+
+                             std::ostringstream line;
+                             if (inResult.m_isOk)
+                             {
+                               line<<"OK     "<<inFile<<" -> "<<inResult.m_outName<<" chunks="<<inResult.m_nbChunks
+                                   <<(m_options.m_fix? " changes="+std::to_string(inResult.m_nbChanges):"")
+                                   <<" bytes="<<inResult.m_sizeInByte<<" time="<<std::fixed<<std::setprecision(2)<<elapsed.count()<<"ms";
+                             }
+                             else
+                             {
+                               line<<"FAILED "<<inFile<<": "<<inResult.m_error;
+                             }
+
+                             std::lock_guard<std::mutex> lock(outputMutex);
+                             ioStream<<line.str()<<std::endl;
+                             nbOk += inResult.m_isOk? 1:0;
+                             totalSize += inResult.m_sizeInByte;
+                             if (m_options.m_pStats)
+                             {
+                               m_options.m_pStats->merge(inResult.m_stats);
+                             }
+                             nbDone++;
+                             doneCondition.notify_all();
+                           };
+
+  for (const auto& file:m_files)
+  {
+    // the budget is taken before queuing so pending files hold no memory
+    std::error_code error;
+    const auto fileSize = std::filesystem::file_size(file, error);
+    const std::size_t charge = error? 0 : fileSize;
+
+    if (charge > m_options.m_maxFileSize)
+    {
+      // rejected from its size, neither read nor queued
+      const CPNG::SError fileError = {CPNG::SError::ECode::FILE_TOO_LARGE, 0, CFourCC(), charge};
+      SFileResult result;
+      result.m_error = "cannot load: " + fileError.get_message();
+      finish_file(file, 0, result, std::chrono::steady_clock::now());
+    }
+    else if (!m_options.m_isInPlace && is_output_input(file))
+    {
+      // an empty suffix, or a link to the input: only --in-place rewrites it
+      SFileResult result;
+      result.m_error = "the output is the input, use --in-place to rewrite it";
+      finish_file(file, 0, result, std::chrono::steady_clock::now());
+    }
+    else if (pEngine)
+    {
+      budget.acquire(charge);
+      const auto fileStart = std::chrono::steady_clock::now();
+      process_file_async(file, limits, *pEngine, pool, [&, file, charge, fileStart](const SFileResult& inResult)
+                                                       {
+                                                         finish_file(file, charge, inResult, fileStart);
+                                                       });
+    }
+    else
+    {
+      budget.acquire(charge);
+      pool.submit([&, file, charge]()
+                  {
+                    const auto fileStart = std::chrono::steady_clock::now();
+                    finish_file(file, charge, process_file(file, limits, pool), fileStart);
+                  });
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock(outputMutex);
+    doneCondition.wait(lock, [&]() { return nbDone == m_files.size(); });
+  }
+  pool.wait_idle();
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+  const double seconds = std::max(elapsed.count(), 1e-9);
+  ioStream<<"Batch: "<<nbOk<<"/"<<m_files.size()<<" files OK, "<<totalSize<<" bytes in "
+          <<std::fixed<<std::setprecision(3)<<seconds<<"s ("
+          <<std::setprecision(1)<<totalSize/seconds/1e6<<" MB/s, "
+          <<m_files.size()/seconds<<" files/s, "<<pool.get_nb_threads()<<" threads"
+          <<(pEngine? std::string(", ") + pEngine->get_backend_name() + " I/O":"")<<")"<<std::endl;
+
+  return nbOk == m_files.size();
+} // run
+
+////////////////////////////////////////////////////////////////////////////
+bool CBatch::is_output_input(const std::string& inName) const
+{
+  const std::string outName = get_output_name(inName, m_options.m_suffix);
+  std::error_code error;
+  return outName == inName || std::filesystem::equivalent(inName, outName, error);
+} // is_output_input
+
+////////////////////////////////////////////////////////////////////////////
+std::string CBatch::get_output_name(const std::string& inName, const std::string& inSuffix)
+{
+  const std::filesystem::path imgFile(inName);
+  return (imgFile.parent_path().string().empty()? "":imgFile.parent_path().string()+"/")+imgFile.stem().string()+inSuffix+imgFile.extension().string();
+} // get_output_name
+
+////////////////////////////////////////////////////////////////////////////
+CBatch::SFileResult CBatch::process_file(const std::string& inName, const SMemoryLimits& inLimits, CThreadPool& ioPool) const
+{
+  SFileResult result;
+  CPNG pngFile;
+  pngFile.set_stats(m_options.m_pStats? &result.m_stats:nullptr);
+  pngFile.set_memory_limits(inLimits);
+
+  if (pngFile.load_from_PNG(inName))
+  {
+    if (process_chunks(pngFile, result, ioPool))
+    {
+      result.m_outName = m_options.m_isInPlace? inName:get_output_name(inName, m_options.m_suffix);
+      const bool isSaved = m_options.m_isInPlace? pngFile.save_in_place(inName, m_options.m_inPlaceMode, ioPool):
+                                                  pngFile.save_to_PNG(result.m_outName, CPNG::ESaveMode::EXTENTS, ioPool);
+      if (isSaved)
+      {
+        std::error_code error;
+        result.m_sizeInByte = std::filesystem::file_size(inName, error);
+        result.m_isOk = true;
+      }
+      else
+      {
+        result.m_error = "cannot save '" + result.m_outName + "'";
+      }
+    }
+  }
+  else
+  {
+    result.m_error = get_load_error(pngFile);
+  }
+
+  return result;
+} // process_file
+
+////////////////////////////////////////////////////////////////////////////
+std::string CBatch::get_load_error(const CPNG& inPngFile)
+{
+  const std::string message = inPngFile.get_last_error().get_message();
+  return message.empty()? "cannot load":"cannot load: " + message;
+} // get_load_error
+
+////////////////////////////////////////////////////////////////////////////
+bool CBatch::process_chunks(CPNG& ioPngFile, SFileResult& ioResult, CThreadPool& ioPool) const
+{
+  ioResult.m_nbChunks = ioPngFile.get_nb_chunks();
+  if (m_options.m_clean)
+  {
+    ioPngFile.clean_chunks();
+  }
+  if (m_options.m_fix)
+  {
+    ioResult.m_nbChanges = ioPngFile.fix_all(ioPool).size();
+  }
+
+  std::vector<std::size_t> autoOrder;
+  if (m_options.m_isAutoOrder && !ioPngFile.find_data_order(autoOrder, ioPool))
+  {
+    ioResult.m_error = "no data order found";
+  }
+  else if (m_options.m_isAutoOrder && !ioPngFile.reorder_data_chunks(autoOrder))
+  {
+    ioResult.m_error = "cannot reorder";
+  }
+  else if (!m_options.m_newOrder.empty() && !ioPngFile.reorder_data_chunks(m_options.m_newOrder))
+  {
+    ioResult.m_error = "cannot reorder";
+  }
+  else if (m_options.m_recompressLevel >= 0 && !ioPngFile.recompress_data(m_options.m_recompressLevel, m_options.m_deflateBlockSize, ioPool))
+  {
+    ioResult.m_error = "cannot recompress";
+  }
+  else if (m_options.m_rechunkSize > 0 && !ioPngFile.rechunk_data(m_options.m_rechunkSize, ioPool))
+  {
+    const std::string message = ioPngFile.get_last_error().get_message();
+    ioResult.m_error = message.empty()? "cannot rechunk":"cannot rechunk: " + message;
+  }
+  else if (m_options.m_verify)
+  {
+    const CPNG::SDataCheck check = ioPngFile.check_data_stream();
+    if (check.m_result != CPNG::SDataCheck::EResult::SOUND)
+    {
+      ioResult.m_error = "unsound data: " + check.get_message();
+    }
+  }
+
+  return ioResult.m_error.empty();
+} // process_chunks
+
+////////////////////////////////////////////////////////////////////////////
+void CBatch::process_file_async(const std::string& inName, const SMemoryLimits& inLimits, CIOEngine& ioEngine, CThreadPool& ioPool,
+                                std::function<void(const SFileResult&)>&& inDone) const
+{
+  ioEngine.read_file(inName, [this, inName, inLimits, &ioEngine, &ioPool, done = std::move(inDone)](sharedByteBuffer inpPngData)
+                             {
+                               // parsing and CRC checks leave the engine thread
+                               ioPool.submit([this, inName, inLimits, &ioEngine, &ioPool, inpPngData, done]()
+                                             {
+                                               std::shared_ptr<CPNG> pPngFile(new CPNG);
+                                               std::shared_ptr<SFileResult> pResult(new SFileResult);
+                                               pPngFile->set_stats(m_options.m_pStats? &pResult->m_stats:nullptr);
+                                               pPngFile->set_memory_limits(inLimits);
+
+                                               if (!inpPngData)
+                                               {
+                                                 pResult->m_error = "cannot load: cannot read";
+                                                 done(*pResult);
+                                               }
+                                               else if (!pPngFile->load_from_buffer(inpPngData))
+                                               {
+                                                 pResult->m_error = get_load_error(*pPngFile);
+                                                 done(*pResult);
+                                               }
+                                               else if (!process_chunks(*pPngFile, *pResult, ioPool))
+                                               {
+                                                 done(*pResult);
+                                               }
+                                               else
+                                               {
+                                                 pResult->m_outName = get_output_name(inName, m_options.m_suffix);
+                                                 pResult->m_sizeInByte = inpPngData->get_size();
+                                                 // the CPNG holds the saved bytes until the writes complete
+                                                 pPngFile->save_to_PNG(pResult->m_outName, ioEngine,
+                                                                       [pPngFile, pResult, done](const bool inIsSaved)
+                                                                       {
+                                                                         pResult->m_isOk = inIsSaved;
+                                                                         if (!inIsSaved)
+                                                                         {
+                                                                           pResult->m_sizeInByte = 0;
+                                                                           pResult->m_error = "cannot save '" + pResult->m_outName + "'";
+                                                                         }
+                                                                         done(*pResult);
+                                                                       }, ioPool);
+                                               }
+                                             });
+                             });
+} // process_file_async
+
+////////////////////////////////////////////////////////////////////////////
+bool CBatch::is_output_name(const std::string& inName) const
+{
+  const std::string stem = std::filesystem::path(inName).stem().string();
+  return !m_options.m_suffix.empty() && stem.size() >= m_options.m_suffix.size() &&
+         stem.compare(stem.size() - m_options.m_suffix.size(), m_options.m_suffix.size(), m_options.m_suffix) == 0;
+} // is_output_name
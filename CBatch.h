@@ -0,0 +1,117 @@
+#pragma once
+
+#include "CInPlaceWriter.h"
+#include "CIOEngine.h"
+#include "CStats.h"
+#include "CThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class CPNG;
+struct SMemoryLimits;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+struct SBatchOptions
+{
+  std::vector<std::size_t> m_newOrder;                    // empty: no reorder
+  bool                     m_isAutoOrder = false;         // order searched from the data stream
+  bool                     m_clean = false;
+  bool                     m_fix = false;
+  std::size_t              m_rechunkSize = 0;             // 0: data chunks kept as is
+  int                      m_recompressLevel = -1;        // -1: data stream kept as is
+  std::size_t              m_deflateBlockSize = 128 << 10;
+  bool                     m_verify = false;              // unsound data streams fail the file
+  std::size_t              m_nbThreads = 0;               // 0: hardware threads
+  std::size_t              m_maxInFlightBytes = 1ull << 30;
+  std::string              m_suffix = "_reordered";
+  SStats                  *m_pStats = nullptr;        // counters of all files merged
+  bool                     m_isInPlace = false;         // rewrite the inputs, no suffix
+  CInPlaceWriter::EMode    m_inPlaceMode = CInPlaceWriter::EMode::JOURNAL;
+  bool                     m_isAsyncIO = false;         // reads and writes on a CIOEngine
+  CIOEngine::EBackend      m_ioBackend = CIOEngine::EBackend::AUTO;
+  std::size_t              m_ioQueueDepth = 64;
+  std::size_t              m_maxChunkSize = 0x7fffffff;   // larger chunks fail the file
+  std::size_t              m_maxFileSize = SIZE_MAX;      // larger files fail before being read
+  std::size_t              m_maxProcessBytes = 0;         // owned by all files, 0: no cap
+}; // struct SBatchOptions
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Apply the same pipeline (clean, fix, reorder, recompress, verify, save) to many
+// files, one CPNG per file, on a work-stealing thread pool with bounded
+// in-flight memory. The deflate blocks of a recompression run on the same
+// pool.
+// With asynchronous I/O the files are read and written by a CIOEngine and
+// the pool only parses and checks them, so the device and the cores work at
+// the same time. In-place rewrites stay synchronous.
+class CBatch
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    explicit CBatch(const SBatchOptions& inOptions);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // inInput is a directory (its png files, recursively), a glob pattern,
+    // '@manifest' (one file per line, '@-' for stdin) or a file.
+    // Return the number of files added.
+    std::size_t add_input(const std::string& inInput);
+
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t get_nb_files() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // One summary line per file then the aggregate throughput. Return true
+    // if every file has been processed.
+    bool run(std::ostream& ioStream);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // dir/stem + inSuffix + extension
+    static std::string get_output_name(const std::string& inName, const std::string& inSuffix);
+
+  private:
+    struct SFileResult
+    {
+      bool        m_isOk = false;
+      std::size_t m_nbChunks = 0;
+      std::size_t m_nbChanges = 0;     // made by the fix
+      std::size_t m_sizeInByte = 0;
+      std::string m_outName;
+      std::string m_error;
+      SStats      m_stats;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Synchronous load, process and save.
+    SFileResult process_file(const std::string& inName, const SMemoryLimits& inLimits, CThreadPool& ioPool) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The output name of inName (suffix added) resolves to inName.
+    bool is_output_input(const std::string& inName) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // "cannot load" and the reason the loader gave.
+    static std::string get_load_error(const CPNG& inPngFile);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Clean, fix, reorder, recompress and rechunk a loaded file. False with
+    // ioResult.m_error set when it cannot be saved.
+    bool process_chunks(CPNG& ioPngFile, SFileResult& ioResult, CThreadPool& ioPool) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Reads and writes on an engine, the processing on ioPool. Return at
+    // once, inDone is called from an engine or pool thread.
+    void process_file_async(const std::string& inName, const SMemoryLimits& inLimits, CIOEngine& ioEngine, CThreadPool& ioPool,
+                            std::function<void(const SFileResult&)>&& inDone) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool is_output_name(const std::string& inName) const;
+
+    SBatchOptions            m_options;
+    std::vector<std::string> m_files;
+}; // class CBatch
@@ -0,0 +1,199 @@
+#include "CByteBuffer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////
+CByteBuffer::CByteBuffer(std::vector<uint8_t>&& inData)
+: m_data(std::move(inData))
+, m_pMapped(nullptr)
+, m_mappedSize(0)
+, m_fd(-1)
+, m_pView(nullptr)
+, m_viewSize(0)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CByteBuffer::CByteBuffer(void *inpMapped, const std::size_t inMappedSize, const int inFd)
+: m_pMapped(inpMapped)
+, m_mappedSize(inMappedSize)
+, m_fd(inFd)
+, m_pView(nullptr)
+, m_viewSize(0)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CByteBuffer::CByteBuffer(const uint8_t *inpView, const std::size_t inViewSize)
+: m_pMapped(nullptr)
+, m_mappedSize(0)
+, m_fd(-1)
+, m_pView(inpView)
+, m_viewSize(inViewSize)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CByteBuffer::~CByteBuffer()
+{
+  if (m_pMapped != nullptr)
+  {
+    munmap(m_pMapped, m_mappedSize);
+  }
+  if (m_fd >= 0)
+  {
+    close(m_fd);
+  }
+} // destructor
+
+////////////////////////////////////////////////////////////////////////////
+sharedByteBuffer CByteBuffer::create(std::vector<uint8_t>&& inData)
+{
+  return std::make_shared<const CByteBuffer>(std::move(inData));
+} // create
+
+////////////////////////////////////////////////////////////////////////////
+sharedByteBuffer CByteBuffer::create_view(const uint8_t *inpData, const std::size_t inSize)
+{
+  return sharedByteBuffer(new CByteBuffer(inpData, inSize));
+} // create_view
+
+////////////////////////////////////////////////////////////////////////////
+sharedByteBuffer CByteBuffer::load_from_file(const std::string& inName, const bool inIsSequential, const std::size_t inMaxSize)
+{
+  sharedByteBuffer pBuffer;
+  int fd = open(inName.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd >= 0)
+  {
+    struct stat fileStat;
+    const bool isRegular = (fstat(fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode));
+    // rejected from its size alone
+    const bool isTooLarge = isRegular && std::size_t(fileStat.st_size) > inMaxSize;
+    if (isRegular && !isTooLarge && fileStat.st_size > 0)
+    {
+      const std::size_t fileSize = fileStat.st_size;
+      void *pMapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (pMapped != MAP_FAILED)
+      {
+        if (inIsSequential)
+        {
+          // the parser walks the file once from the start
+          madvise(pMapped, fileSize, MADV_SEQUENTIAL);
+          madvise(pMapped, fileSize, MADV_WILLNEED);
+        }
+        else
+        {
+          madvise(pMapped, fileSize, MADV_RANDOM);
+        }
+        // the descriptor is kept for kernel-side copies on save
+        pBuffer.reset(new CByteBuffer(pMapped, fileSize, fd));
+        fd = -1;
+      }
+    }
+
+    if (!pBuffer)
+    {
+      std::vector<uint8_t> data;
+      if (!isTooLarge && read_all(fd, data, inMaxSize))
+      {
+        pBuffer = create(std::move(data));
+      }
+      close(fd);
+    }
+  }
+
+  return pBuffer;
+} // load_from_file
+
+////////////////////////////////////////////////////////////////////////////
+bool CByteBuffer::read_at(const std::size_t inIndex, uint8_t *outpData, const std::size_t inSize) const
+{
+  bool retVal = (inIndex <= get_size() && inSize <= get_size() - inIndex);
+  if (retVal && m_pMapped != nullptr)
+  {
+    std::size_t nbRead = 0;
+    while (retVal && nbRead < inSize)
+    {
+      const ssize_t result = pread(m_fd, outpData + nbRead, inSize - nbRead, inIndex + nbRead);
+      if (result > 0)
+      {
+        nbRead += result;
+      }
+      else
+      {
+        retVal = (result < 0 && errno == EINTR);
+      }
+    }
+  }
+  else if (retVal)
+  {
+    std::memcpy(outpData, get_data() + inIndex, inSize);
+  }
+  return retVal;
+} // read_at
+
+////////////////////////////////////////////////////////////////////////////
+bool CByteBuffer::read_all(const int inFd, std::vector<uint8_t>& outData, const std::size_t inMaxSize)
+{
+  constexpr std::size_t READ_SIZE = 1 << 16;
+  bool retVal = true;
+  std::size_t size = 0;
+  outData.clear();
+
+  while (retVal)
+  {
+    outData.resize(size + READ_SIZE);
+    const ssize_t nbRead = read(inFd, outData.data() + size, READ_SIZE);
+    if (nbRead > 0)
+    {
+      size += nbRead;
+      retVal = (size <= inMaxSize);
+    }
+    else if (nbRead == 0)
+    {
+      break;
+    }
+    else if (errno != EINTR)
+    {
+      retVal = false;
+    }
+  }
+  outData.resize(size);
+
+  return retVal;
+} // read_all
+
+////////////////////////////////////////////////////////////////////////////
+const uint8_t* CByteBuffer::get_data() const
+{
+  return m_pMapped != nullptr? (const uint8_t*)m_pMapped : (m_pView != nullptr? m_pView : m_data.data());
+} // get_data
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CByteBuffer::get_size() const
+{
+  return m_pMapped != nullptr? m_mappedSize : (m_pView != nullptr? m_viewSize : m_data.size());
+} // get_size
+
+////////////////////////////////////////////////////////////////////////////
+int CByteBuffer::get_file_descriptor() const
+{
+  return m_fd;
+} // get_file_descriptor
+
+////////////////////////////////////////////////////////////////////////////
+bool CByteBuffer::is_mapped() const
+{
+  return m_pMapped != nullptr;
+} // is_mapped
+
+////////////////////////////////////////////////////////////////////////////
+bool CByteBuffer::is_owned() const
+{
+  return m_pMapped == nullptr && m_pView == nullptr;
+} // is_owned
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CByteBuffer;
+using sharedByteBuffer = std::shared_ptr<const CByteBuffer>;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Read-only bytes shared by all the chunks viewing them, either owned in
+// memory or mapped from a file.
+class CByteBuffer
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    explicit CByteBuffer(std::vector<uint8_t>&& inData);
+
+    ////////////////////////////////////////////////////////////////////////////
+    ~CByteBuffer();
+
+    ////////////////////////////////////////////////////////////////////////////
+    CByteBuffer(const CByteBuffer&) = delete;
+    CByteBuffer& operator=(const CByteBuffer&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    static sharedByteBuffer create(std::vector<uint8_t>&& inData);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Borrow memory held by the caller, no copy: it must outlive the buffer.
+    static sharedByteBuffer create_view(const uint8_t *inpData, const std::size_t inSize);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Map a regular file read-only, or read it when it cannot be mapped
+    // (pipes, character devices...). Return nullptr on error.
+    // inIsSequential false maps for sparse accesses: no read-ahead, the
+    // pages are read from the file when touched.
+    // A file of more than inMaxSize bytes is rejected before being mapped
+    // or read.
+    static sharedByteBuffer load_from_file(const std::string& inName, const bool inIsSequential = true,
+                                           const std::size_t inMaxSize = SIZE_MAX);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Copy inSize bytes at inIndex, with a pread for a mapped file so that
+    // its mapping is not faulted in. False out of range or on I/O errors.
+    bool read_at(const std::size_t inIndex, uint8_t *outpData, const std::size_t inSize) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    const uint8_t* get_data() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t get_size() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool is_mapped() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The bytes are held by the buffer: neither mapped nor borrowed.
+    bool is_owned() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Descriptor of the mapped file, offsets in the buffer are offsets in the
+    // file. -1 when the buffer is not backed by a regular file.
+    int get_file_descriptor() const;
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    CByteBuffer(void *inpMapped, const std::size_t inMappedSize, const int inFd);
+
+    ////////////////////////////////////////////////////////////////////////////
+    CByteBuffer(const uint8_t *inpView, const std::size_t inViewSize);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Buffered read of the whole descriptor until EOF, false past inMaxSize
+    // bytes.
+    static bool read_all(const int inFd, std::vector<uint8_t>& outData, const std::size_t inMaxSize);
+
+    std::vector<uint8_t> m_data;
+    void                *m_pMapped;
+    std::size_t          m_mappedSize;
+    int                  m_fd;
+    const uint8_t       *m_pView;
+    std::size_t          m_viewSize;
+}; // class CByteBuffer
@@ -1,12 +1,229 @@
 #include "CCRC32.h"
 
+#include <vector>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define CCRC32_HAS_X86_KERNELS 1
+  #include <immintrin.h>
+#endif
+
+// Under this size the folding kernels are not worth their setup.
+constexpr std::size_t PCLMUL_MIN_SIZE  = 64;
+constexpr std::size_t VPCLMUL_MIN_SIZE = 256;
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 uint32_t CCRC32::compute(const uint8_t *inpBuffer, std::size_t inBufSizeInByte)
 {
-  return update_crc(0xffffffffL, inpBuffer, inBufSizeInByte) ^ 0xffffffffL;
+  return update_crc(0xffffffffL, inpBuffer, inBufSizeInByte, get_kernel()) ^ 0xffffffffL;
+} // compute
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::compute(const uint8_t *inpBuffer, std::size_t inBufSizeInByte, const EKernel inKernel)
+{
+  return update_crc(0xffffffffL, inpBuffer, inBufSizeInByte, inKernel) ^ 0xffffffffL;
 } // compute
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::update(const uint32_t inCRC, const uint8_t *inpBuffer, std::size_t inBufSizeInByte)
+{
+  return update_crc(inCRC, inpBuffer, inBufSizeInByte, get_kernel());
+} // update
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::combine(const uint32_t inCRC1, const uint32_t inCRC2, const std::size_t inSize2)
+{
+  // crc1 shifted by 8*inSize2 zero bits, then xored with crc2
+  return multiply_mod_poly(x_pow_2n_mod_poly(inSize2, 3), inCRC1) ^ inCRC2;
+} // combine
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::multiply_mod_poly(uint32_t inA, uint32_t inB)
+{
+  uint32_t mask = (uint32_t)1 << 31;
+  uint32_t product = 0;
+  while (mask != 0)
+  {
+    if (inA & mask)
+    {
+      product ^= inB;
+      if ((inA & (mask - 1)) == 0)
+      {
+        break;
+      }
+    }
+    mask >>= 1;
+    inB = (inB & 1)? (inB >> 1) ^ 0xedb88320L : inB >> 1;
+  }
+  return product;
+} // multiply_mod_poly
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::x_pow_2n_mod_poly(std::size_t inN, unsigned inK)
+{
+  // x^(2^k) for k = 0..31, the sequence is periodic after
+  static const auto x2nTable = []()
+  {
+    std::array<uint32_t, 32> table{};
+    uint32_t p = (uint32_t)1 << 30; // x^1
+    table[0] = p;
+    for (std::size_t n = 1; n < table.size(); n++)
+    {
+      table[n] = p = multiply_mod_poly(p, p);
+    }
+    return table;
+  }();
+
+  uint32_t p = (uint32_t)1 << 31; // x^0
+  while (inN != 0)
+  {
+    if (inN & 1)
+    {
+      p = multiply_mod_poly(x2nTable[inK & 31], p);
+    }
+    inN >>= 1;
+    inK++;
+  }
+  return p;
+} // x_pow_2n_mod_poly
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+CCRC32::EKernel CCRC32::get_kernel()
+{
+  static const EKernel kernel = select_kernel();
+  return kernel;
+} // get_kernel
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CCRC32::is_kernel_supported(const EKernel inKernel)
+{
+  bool retVal = false;
+  switch (inKernel)
+  {
+    case EKernel::TABLE:
+    case EKernel::SLICING_BY_8:
+    case EKernel::SLICING_BY_16:
+      retVal = true;
+      break;
+#ifdef CCRC32_HAS_X86_KERNELS
+    case EKernel::PCLMUL:
+      retVal = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+      break;
+    case EKernel::VPCLMUL:
+      retVal = is_kernel_supported(EKernel::PCLMUL) && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("vpclmulqdq");
+      break;
+#endif
+    default:
+      break;
+  }
+  return retVal;
+} // is_kernel_supported
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const char* CCRC32::get_kernel_name(const EKernel inKernel)
+{
+  switch (inKernel)
+  {
+    case EKernel::TABLE:         return "table";
+    case EKernel::SLICING_BY_8:  return "slicing-by-8";
+    case EKernel::SLICING_BY_16: return "slicing-by-16";
+    case EKernel::PCLMUL:        return "pclmul";
+    case EKernel::VPCLMUL:       return "vpclmul";
+  }
+  return "unknown";
+} // get_kernel_name
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+CCRC32::EKernel CCRC32::select_kernel()
+{
+  EKernel kernel = EKernel::SLICING_BY_16;
+  if (is_kernel_supported(EKernel::VPCLMUL))
+  {
+    kernel = EKernel::VPCLMUL;
+  }
+  else if (is_kernel_supported(EKernel::PCLMUL))
+  {
+    kernel = EKernel::PCLMUL;
+  }
+  return kernel;
+} // select_kernel
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CCRC32::self_test(std::ostream& oStream, const std::size_t inNbBuffers)
+{
+  bool retVal = true;
+  std::mt19937 generator(0x89504e47);
+  std::uniform_int_distribution<std::size_t> sizeDistribution(0, 4096);
+  std::uniform_int_distribution<std::size_t> offsetDistribution(0, 63);
+  std::uniform_int_distribution<int> byteDistribution(0, 255);
+
+  constexpr EKernel KERNELS[] = {EKernel::SLICING_BY_8, EKernel::SLICING_BY_16, EKernel::PCLMUL, EKernel::VPCLMUL};
+
+  std::vector<uint8_t> buffer;
+  for (auto kernel:KERNELS)
+  {
+    if (!is_kernel_supported(kernel))
+    {
+      oStream<<"CRC32 kernel "<<get_kernel_name(kernel)<<": not supported"<<std::endl;
+      continue;
+    }
+
+    std::size_t nbErrors = 0;
+    for (std::size_t i = 0; i < inNbBuffers; i++)
+    {
+      // some buffers are large enough to run the main folding loops several times
+      const std::size_t size = (i % 16 == 0)? sizeDistribution(generator)*64 : sizeDistribution(generator);
+      const std::size_t offset = offsetDistribution(generator);
+      buffer.resize(offset + size);
+      for (auto& byte:buffer)
+      {
+        byte = (uint8_t)byteDistribution(generator);
+      }
+
+      if (compute(buffer.data()+offset, size, kernel) != compute(buffer.data()+offset, size, EKernel::TABLE))
+      {
+        nbErrors++;
+      }
+    }
+
+    oStream<<"CRC32 kernel "<<get_kernel_name(kernel)<<": "<<(nbErrors == 0? "OK":"FAILED")<<" ("<<nbErrors<<" errors on "<<inNbBuffers<<" buffers)"<<std::endl;
+    retVal &= (nbErrors == 0);
+  }
+
+  std::size_t nbCombineErrors = 0;
+  for (std::size_t i = 0; i < inNbBuffers; i++)
+  {
+    const std::size_t size = sizeDistribution(generator);
+    const std::size_t split = size? sizeDistribution(generator) % (size + 1) : 0;
+    buffer.resize(size);
+    for (auto& byte:buffer)
+    {
+      byte = (uint8_t)byteDistribution(generator);
+    }
+    const uint32_t combined = combine(compute(buffer.data(), split), compute(buffer.data() + split, size - split), size - split);
+    if (combined != compute(buffer.data(), size, EKernel::TABLE))
+    {
+      nbCombineErrors++;
+    }
+  }
+  oStream<<"CRC32 combine: "<<(nbCombineErrors == 0? "OK":"FAILED")<<" ("<<nbCombineErrors<<" errors on "<<inNbBuffers<<" buffers)"<<std::endl;
+  retVal &= (nbCombineErrors == 0);
+
+  oStream<<"CRC32 selected kernel: "<<get_kernel_name(get_kernel())<<std::endl;
+  return retVal;
+} // self_test
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 std::array<uint32_t, 256> CCRC32::generate_crc_lookup_table()
@@ -34,6 +251,33 @@ std::array<uint32_t, 256> CCRC32::generate_crc_lookup_table()
   return table;
 } // generate_crc_lookup_table
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+CCRC32::lookupTables CCRC32::generate_slicing_lookup_tables()
+{
+  auto tables = lookupTables{};
+  tables[0] = generate_crc_lookup_table();
+
+  // tables[k][n] is the CRC of byte n followed by k zero bytes
+  for (std::size_t k = 1; k < tables.size(); k++)
+  {
+    for (std::size_t n = 0; n < 256; n++)
+    {
+      const uint32_t previous = tables[k-1][n];
+      tables[k][n] = tables[0][previous & 0xff] ^ (previous >> 8);
+    }
+  }
+  return tables;
+} // generate_slicing_lookup_tables
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const CCRC32::lookupTables& CCRC32::get_lookup_tables()
+{
+  static const auto tables = generate_slicing_lookup_tables();
+  return tables;
+} // get_lookup_tables
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 uint32_t CCRC32::update_crc(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte)
@@ -47,3 +291,273 @@ uint32_t CCRC32::update_crc(const uint32_t inCRC, const unsigned char *inpBuffer
   }
   return crc;
 } // update_crc
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::update_crc(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte, const EKernel inKernel)
+{
+  uint32_t crc = inCRC;
+  switch (inKernel)
+  {
+    case EKernel::SLICING_BY_8:
+      crc = update_crc_slicing_by_8(crc, inpBuffer, inBufSizeInByte);
+      break;
+    case EKernel::SLICING_BY_16:
+      crc = update_crc_slicing_by_16(crc, inpBuffer, inBufSizeInByte);
+      break;
+    case EKernel::PCLMUL:
+      crc = update_crc_pclmul(crc, inpBuffer, inBufSizeInByte);
+      break;
+    case EKernel::VPCLMUL:
+      crc = update_crc_vpclmul(crc, inpBuffer, inBufSizeInByte);
+      break;
+    case EKernel::TABLE:
+    default:
+      crc = update_crc(crc, inpBuffer, inBufSizeInByte);
+      break;
+  }
+  return crc;
+} // update_crc
+
+////////////////////////////////////////////////////////////////////////////////
+// Little endian read, whatever the host endianness.
+static inline uint32_t read_le32(const unsigned char *inpBuffer)
+{
+  return (uint32_t)inpBuffer[0] | ((uint32_t)inpBuffer[1] << 8) | ((uint32_t)inpBuffer[2] << 16) | ((uint32_t)inpBuffer[3] << 24);
+} // read_le32
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::update_crc_slicing_by_8(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte)
+{
+  const auto& t = get_lookup_tables();
+  uint32_t crc = inCRC;
+
+  while (inBufSizeInByte >= 8)
+  {
+    const uint32_t one = read_le32(inpBuffer) ^ crc;
+    const uint32_t two = read_le32(inpBuffer + 4);
+    crc = t[7][ one        & 0xff] ^ t[6][(one >>  8) & 0xff] ^
+          t[5][(one >> 16) & 0xff] ^ t[4][ one >> 24        ] ^
+          t[3][ two        & 0xff] ^ t[2][(two >>  8) & 0xff] ^
+          t[1][(two >> 16) & 0xff] ^ t[0][ two >> 24        ];
+    inpBuffer += 8;
+    inBufSizeInByte -= 8;
+  }
+
+  return update_crc(crc, inpBuffer, inBufSizeInByte);
+} // update_crc_slicing_by_8
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::update_crc_slicing_by_16(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte)
+{
+  const auto& t = get_lookup_tables();
+  uint32_t crc = inCRC;
+
+  while (inBufSizeInByte >= 16)
+  {
+    const uint32_t one   = read_le32(inpBuffer) ^ crc;
+    const uint32_t two   = read_le32(inpBuffer + 4);
+    const uint32_t three = read_le32(inpBuffer + 8);
+    const uint32_t four  = read_le32(inpBuffer + 12);
+    crc = t[15][ one          & 0xff] ^ t[14][(one   >>  8) & 0xff] ^
+          t[13][(one   >> 16) & 0xff] ^ t[12][ one   >> 24        ] ^
+          t[11][ two          & 0xff] ^ t[10][(two   >>  8) & 0xff] ^
+          t[ 9][(two   >> 16) & 0xff] ^ t[ 8][ two   >> 24        ] ^
+          t[ 7][ three        & 0xff] ^ t[ 6][(three >>  8) & 0xff] ^
+          t[ 5][(three >> 16) & 0xff] ^ t[ 4][ three >> 24        ] ^
+          t[ 3][ four         & 0xff] ^ t[ 2][(four  >>  8) & 0xff] ^
+          t[ 1][(four  >> 16) & 0xff] ^ t[ 0][ four  >> 24        ];
+    inpBuffer += 16;
+    inBufSizeInByte -= 16;
+  }
+
+  return update_crc(crc, inpBuffer, inBufSizeInByte);
+} // update_crc_slicing_by_16
+
+#ifdef CCRC32_HAS_X86_KERNELS
+/*
+   Folding constants for the reflected polynomial 0x104c11db7, a pair is
+   (x^(D+32) mod P, x^(D-32) mod P) bit-reflected and shifted left by one
+   for a folding distance of D bits.
+*/
+alignas(16) static const uint64_t K_FOLD_2048[] = {0x011542778a, 0x01322d1430};
+alignas(16) static const uint64_t K_FOLD_512[]  = {0x0154442bd4, 0x01c6e41596};
+alignas(16) static const uint64_t K_FOLD_128[]  = {0x01751997d0, 0x00ccaa009e};
+alignas(16) static const uint64_t K_FOLD_64[]   = {0x0163cd6124, 0x0000000000};
+// Barrett reduction: P' and mu
+alignas(16) static const uint64_t K_BARRETT[]   = {0x01db710641, 0x01f7011641};
+
+////////////////////////////////////////////////////////////////////////////////
+// Fold one 128-bit accumulator over the next 128 bits of data.
+__attribute__((target("pclmul,sse4.1")))
+static inline __m128i fold_128(const __m128i inAcc, const __m128i inData, const __m128i inK)
+{
+  const __m128i lo = _mm_clmulepi64_si128(inAcc, inK, 0x00);
+  const __m128i hi = _mm_clmulepi64_si128(inAcc, inK, 0x11);
+  return _mm_xor_si128(_mm_xor_si128(hi, lo), inData);
+} // fold_128
+
+////////////////////////////////////////////////////////////////////////////////
+// Fold 4 accumulators into one, then the remaining 16-byte blocks, then
+// reduce to the 32-bit running CRC.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t reduce_pclmul(__m128i x1, const __m128i x2, const __m128i x3, const __m128i x4,
+                              const unsigned char *inpBuffer, std::size_t inBufSizeInByte)
+{
+  const __m128i k128 = _mm_load_si128((const __m128i*)K_FOLD_128);
+
+  x1 = fold_128(x1, x2, k128);
+  x1 = fold_128(x1, x3, k128);
+  x1 = fold_128(x1, x4, k128);
+
+  while (inBufSizeInByte >= 16)
+  {
+    x1 = fold_128(x1, _mm_loadu_si128((const __m128i*)inpBuffer), k128);
+    inpBuffer += 16;
+    inBufSizeInByte -= 16;
+  }
+
+  // 128 bits to 64 bits
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  __m128i x0 = _mm_clmulepi64_si128(x1, k128, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x0);
+
+  x0 = _mm_loadl_epi64((const __m128i*)K_FOLD_64);
+  __m128i x2b = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2b);
+
+  // Barrett reduction to 32 bits
+  x0 = _mm_load_si128((const __m128i*)K_BARRETT);
+  x2b = _mm_and_si128(x1, mask32);
+  x2b = _mm_clmulepi64_si128(x2b, x0, 0x10);
+  x2b = _mm_and_si128(x2b, mask32);
+  x2b = _mm_clmulepi64_si128(x2b, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2b);
+
+  return (uint32_t)_mm_extract_epi32(x1, 1);
+} // reduce_pclmul
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("pclmul,sse4.1")))
+uint32_t CCRC32::update_crc_pclmul(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte)
+{
+  if (inBufSizeInByte < PCLMUL_MIN_SIZE)
+  {
+    return update_crc_slicing_by_16(inCRC, inpBuffer, inBufSizeInByte);
+  }
+
+  const std::size_t foldedSize = inBufSizeInByte & ~(std::size_t)15;
+  const unsigned char *pTail = inpBuffer + foldedSize;
+  const std::size_t tailSize = inBufSizeInByte - foldedSize;
+  std::size_t size = foldedSize;
+
+  __m128i x1 = _mm_loadu_si128((const __m128i*)(inpBuffer + 0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i*)(inpBuffer + 0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i*)(inpBuffer + 0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i*)(inpBuffer + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)inCRC));
+  inpBuffer += 64;
+  size -= 64;
+
+  const __m128i k512 = _mm_load_si128((const __m128i*)K_FOLD_512);
+  while (size >= 64)
+  {
+    x1 = fold_128(x1, _mm_loadu_si128((const __m128i*)(inpBuffer + 0x00)), k512);
+    x2 = fold_128(x2, _mm_loadu_si128((const __m128i*)(inpBuffer + 0x10)), k512);
+    x3 = fold_128(x3, _mm_loadu_si128((const __m128i*)(inpBuffer + 0x20)), k512);
+    x4 = fold_128(x4, _mm_loadu_si128((const __m128i*)(inpBuffer + 0x30)), k512);
+    inpBuffer += 64;
+    size -= 64;
+  }
+
+  const uint32_t crc = reduce_pclmul(x1, x2, x3, x4, inpBuffer, size);
+  return update_crc_slicing_by_16(crc, pTail, tailSize);
+} // update_crc_pclmul
+
+////////////////////////////////////////////////////////////////////////////////
+// Fold four 128-bit lanes at once.
+__attribute__((target("avx512f,vpclmulqdq")))
+static inline __m512i fold_512(const __m512i inAcc, const __m512i inData, const __m512i inK)
+{
+  const __m512i lo = _mm512_clmulepi64_epi128(inAcc, inK, 0x00);
+  const __m512i hi = _mm512_clmulepi64_epi128(inAcc, inK, 0x11);
+  return _mm512_ternarylogic_epi64(hi, lo, inData, 0x96);
+} // fold_512
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("avx512f,vpclmulqdq,pclmul,sse4.1")))
+uint32_t CCRC32::update_crc_vpclmul(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte)
+{
+  if (inBufSizeInByte < VPCLMUL_MIN_SIZE)
+  {
+    return update_crc_pclmul(inCRC, inpBuffer, inBufSizeInByte);
+  }
+
+  const std::size_t foldedSize = inBufSizeInByte & ~(std::size_t)15;
+  const unsigned char *pTail = inpBuffer + foldedSize;
+  const std::size_t tailSize = inBufSizeInByte - foldedSize;
+  std::size_t size = foldedSize;
+
+  __m512i z1 = _mm512_loadu_si512((const void*)(inpBuffer + 0x00));
+  __m512i z2 = _mm512_loadu_si512((const void*)(inpBuffer + 0x40));
+  __m512i z3 = _mm512_loadu_si512((const void*)(inpBuffer + 0x80));
+  __m512i z4 = _mm512_loadu_si512((const void*)(inpBuffer + 0xc0));
+  z1 = _mm512_xor_si512(z1, _mm512_zextsi128_si512(_mm_cvtsi32_si128((int)inCRC)));
+  inpBuffer += 256;
+  size -= 256;
+
+  // 4 x 512 bits per iteration
+  const __m512i k2048 = _mm512_set_epi64(K_FOLD_2048[1], K_FOLD_2048[0], K_FOLD_2048[1], K_FOLD_2048[0],
+                                         K_FOLD_2048[1], K_FOLD_2048[0], K_FOLD_2048[1], K_FOLD_2048[0]);
+  while (size >= 256)
+  {
+    z1 = fold_512(z1, _mm512_loadu_si512((const void*)(inpBuffer + 0x00)), k2048);
+    z2 = fold_512(z2, _mm512_loadu_si512((const void*)(inpBuffer + 0x40)), k2048);
+    z3 = fold_512(z3, _mm512_loadu_si512((const void*)(inpBuffer + 0x80)), k2048);
+    z4 = fold_512(z4, _mm512_loadu_si512((const void*)(inpBuffer + 0xc0)), k2048);
+    inpBuffer += 256;
+    size -= 256;
+  }
+
+  // 4 accumulators into one, then the remaining 512-bit blocks
+  const __m512i k512 = _mm512_set_epi64(K_FOLD_512[1], K_FOLD_512[0], K_FOLD_512[1], K_FOLD_512[0],
+                                        K_FOLD_512[1], K_FOLD_512[0], K_FOLD_512[1], K_FOLD_512[0]);
+  z1 = fold_512(z1, z2, k512);
+  z1 = fold_512(z1, z3, k512);
+  z1 = fold_512(z1, z4, k512);
+  while (size >= 64)
+  {
+    z1 = fold_512(z1, _mm512_loadu_si512((const void*)inpBuffer), k512);
+    inpBuffer += 64;
+    size -= 64;
+  }
+
+  alignas(64) __m128i lanes[4];
+  _mm512_store_si512((void*)lanes, z1);
+  const uint32_t crc = reduce_pclmul(lanes[0], lanes[1], lanes[2], lanes[3], inpBuffer, size);
+  return update_crc_slicing_by_16(crc, pTail, tailSize);
+} // update_crc_vpclmul
+
+#else
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::update_crc_pclmul(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte)
+{
+  return update_crc_slicing_by_16(inCRC, inpBuffer, inBufSizeInByte);
+} // update_crc_pclmul
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+uint32_t CCRC32::update_crc_vpclmul(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte)
+{
+  return update_crc_slicing_by_16(inCRC, inpBuffer, inBufSizeInByte);
+} // update_crc_vpclmul
+
+#endif // CCRC32_HAS_X86_KERNELS
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -9,16 +12,79 @@ class CCRC32
 
   public:
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Available CRC kernels, TABLE is the byte-at-a-time reference.
+    enum class EKernel
+    {
+      TABLE,
+      SLICING_BY_8,
+      SLICING_BY_16,
+      PCLMUL,
+      VPCLMUL
+    };
+
+    static constexpr uint32_t INIT = 0xffffffff;
+
     ////////////////////////////////////////////////////////////////////////////
     // Return the CRC of the bytes buf[0..len-1].
     static uint32_t compute(const uint8_t *inpBuffer, std::size_t inBufSizeInByte);
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Same as above but with the given kernel (must be supported).
+    static uint32_t compute(const uint8_t *inpBuffer, std::size_t inBufSizeInByte, const EKernel inKernel);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Update a running CRC with the bytes buf[0..len-1] using the selected
+    // kernel, the running CRC starts at INIT and compute() == update(INIT, ...)^INIT.
+    static uint32_t update(const uint32_t inCRC, const uint8_t *inpBuffer, std::size_t inBufSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // CRC of A followed by B from crc(A), crc(B) and the size of B, without
+    // reading the bytes again (zlib crc32_combine).
+    static uint32_t combine(const uint32_t inCRC1, const uint32_t inCRC2, const std::size_t inSize2);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Kernel selected at startup from CPUID.
+    static EKernel get_kernel();
+
+    ////////////////////////////////////////////////////////////////////////////
+    static bool is_kernel_supported(const EKernel inKernel);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static const char* get_kernel_name(const EKernel inKernel);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Check every supported kernel, and combine, against the TABLE kernel on
+    // random buffers.
+    static bool self_test(std::ostream& oStream, const std::size_t inNbBuffers = 2000);
+
   private:
 
+    using lookupTables = std::array<std::array<uint32_t, 256>, 16>;
+
     ////////////////////////////////////////////////////////////////////////////
     // Make the table for a fast CRC.
     static std::array<uint32_t, 256> generate_crc_lookup_table();
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Make the 16 tables used by the slicing kernels, the first one is the
+    // byte-at-a-time table.
+    static lookupTables generate_slicing_lookup_tables();
+
+    ////////////////////////////////////////////////////////////////////////////
+    static const lookupTables& get_lookup_tables();
+
+    ////////////////////////////////////////////////////////////////////////////
+    static EKernel select_kernel();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // a(x)*b(x) modulo the CRC polynomial, reflected.
+    static uint32_t multiply_mod_poly(uint32_t inA, uint32_t inB);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // x^(inN*2^inK) modulo the CRC polynomial, reflected.
+    static uint32_t x_pow_2n_mod_poly(std::size_t inN, unsigned inK);
+
     ////////////////////////////////////////////////////////////////////////////
     // Update a running CRC with the bytes buf[0..len-1]--the CRC
     // should be initialized to all 1's, and the transmitted value
@@ -26,4 +92,20 @@ class CCRC32
     // crc() routine below)).
     static uint32_t update_crc(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte);
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Same contract as update_crc, with the given kernel.
+    static uint32_t update_crc(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte, const EKernel inKernel);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static uint32_t update_crc_slicing_by_8(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static uint32_t update_crc_slicing_by_16(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static uint32_t update_crc_pclmul(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static uint32_t update_crc_vpclmul(const uint32_t inCRC, const unsigned char *inpBuffer, std::size_t inBufSizeInByte);
+
 }; // CCRC32
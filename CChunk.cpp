@@ -1,6 +1,8 @@
 #include "CChunk.h"
 #include "CCRC32.h"
+#include "CImageHeader.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <limits.h>
@@ -29,35 +31,92 @@ T swap_endian(T u)
 } // swap_endian
 
 ////////////////////////////////////////////////////////////////////////////
-CChunk::CChunk(const std::string& inType, const std::size_t inSizeInByte)
+CChunk::CChunk()
+: m_dataSize(0)
+, m_crc32(0)
+, m_computedCRC32(0)
+, m_pData(nullptr)
+, m_pSource(nullptr)
+, m_isComputedCRC32Cached(false)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CChunk::CChunk(const CFourCC inType, const std::size_t inSizeInByte, CArena& ioArena)
 : m_dataSize(inSizeInByte)
+, m_type(inType)
+, m_crc32(0)
+, m_computedCRC32(0)
+, m_pData(nullptr)
+, m_pSource(nullptr)
+, m_isComputedCRC32Cached(false)
+{
+  m_pData = ioArena.allocate(inSizeInByte);
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CChunk::CChunk(const std::vector<uint8_t>& inData, const std::size_t inIndex, CArena& ioArena)
+: m_dataSize(0)
+, m_crc32(0)
+, m_computedCRC32(0)
+, m_pData(nullptr)
+, m_pSource(nullptr)
+, m_isComputedCRC32Cached(false)
 {
-  std::memset(m_type, 0, sizeof(m_type));
-  if (inType.size()==sizeof(m_type))
+  const uint8_t *pData = read_header(inData.data(), inData.size(), inIndex);
+  if (pData != nullptr)
   {
-    std::memcpy(m_type, inType.data(), sizeof(m_type));
+    uint8_t *pOwnedData = ioArena.allocate(m_dataSize);
+    std::memcpy(pOwnedData, pData, m_dataSize);
+    m_pData = pOwnedData;
   }
-  else
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CChunk::CChunk(const CByteBuffer& inSource, const std::size_t inIndex)
+: m_dataSize(0)
+, m_crc32(0)
+, m_computedCRC32(0)
+, m_pData(nullptr)
+, m_pSource(nullptr)
+, m_isComputedCRC32Cached(false)
+{
+  const uint8_t *pData = read_header(inSource.get_data(), inSource.get_size(), inIndex);
+  if (pData != nullptr)
   {
-    std::cerr<<"Wrong given type, size="<<inType.size()<<" but 4 expected."<<std::endl;
+    m_pData = pData;
+    m_pSource = &inSource;
   }
-  m_data.resize(inSizeInByte, 0);
 } // constructor
 
 ////////////////////////////////////////////////////////////////////////////
-CChunk::CChunk(const std::vector<uint8_t>& inData, const std::size_t inIndex)
+CChunk::CChunk(const CByteBuffer& inSource, const std::size_t inIndex, const uint8_t *inpHeader, const uint8_t *inpCRC32)
+: m_dataSize(get_data_size(inpHeader))
+, m_crc32(swap_endian<uint32_t>(*(const uint32_t*)inpCRC32))
+, m_computedCRC32(0)
+, m_pData(inSource.get_data() + inIndex + sizeof(m_dataSize) + sizeof(m_type))
+, m_pSource(&inSource)
+, m_isComputedCRC32Cached(false)
 {
-  if (inIndex + get_header_size() <= inData.size())
+  m_type = CFourCC::from_bytes(inpHeader + sizeof(m_dataSize));
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+const uint8_t* CChunk::read_header(const uint8_t *inpBuffer, const std::size_t inBufSize, const std::size_t inIndex)
+{
+  const uint8_t *pData = nullptr;
+  m_type = CFourCC();
+  if (inIndex + get_header_size() <= inBufSize)
   {
-    const uint8_t *pChunkData = inData.data() + inIndex;
-    m_dataSize = swap_endian<uint32_t>(*(uint32_t*)pChunkData);
-    if (inIndex + get_header_size() + m_dataSize <= inData.size() )
+    const uint8_t *pChunkData = inpBuffer + inIndex;
+    const uint32_t dataSize = swap_endian<uint32_t>(*(uint32_t*)pChunkData);
+    if (inIndex + get_header_size() + dataSize <= inBufSize)
     {
+      m_dataSize = dataSize;
       pChunkData += sizeof(m_dataSize);
-      std::memcpy(m_type, pChunkData, sizeof(m_type));
+      m_type = CFourCC::from_bytes(pChunkData);
       pChunkData += sizeof(m_type);
-      m_data.resize(m_dataSize);
-      std::memcpy(m_data.data(), pChunkData, m_dataSize);
+      pData = pChunkData;
       pChunkData += m_dataSize;
       m_crc32 = swap_endian<uint32_t>(*(uint32_t*)pChunkData);
     }
@@ -70,7 +129,8 @@ CChunk::CChunk(const std::vector<uint8_t>& inData, const std::size_t inIndex)
   {
     std::cerr<<"Chunk construction request: index out of range ("<<inIndex<<")"<<std::endl;
   }
-} // constructor 
+  return pData;
+} // read_header
 
 ////////////////////////////////////////////////////////////////////////////
 void CChunk::dump(std::ostream& ioStream, bool inOneLine)
@@ -94,8 +154,10 @@ void CChunk::dump(std::ofstream& ofStream)
 {
   uint32_t localData = swap_endian<uint32_t>(m_dataSize);
   ofStream.write((const char*)&localData, sizeof(localData));
-  ofStream.write(m_type, sizeof(m_type));
-  ofStream.write((const char*)m_data.data(), m_data.size());
+  uint8_t type[sizeof(m_type)];
+  m_type.to_bytes(type);
+  ofStream.write((const char*)type, sizeof(type));
+  ofStream.write((const char*)get_data(), m_dataSize);
   localData = swap_endian<uint32_t>(m_crc32);
   ofStream.write((const char*)&localData, sizeof(localData));
 } // dump
@@ -103,13 +165,37 @@ void CChunk::dump(std::ofstream& ofStream)
 ////////////////////////////////////////////////////////////////////////////
 uint32_t CChunk::compute_CRC32() const
 {
-  std::vector<uint8_t> localData;
-  localData.resize(m_dataSize+sizeof(m_type));
-  std::memcpy(localData.data(), m_type, sizeof(m_type));
-  std::memcpy(localData.data()+sizeof(m_type), m_data.data(), m_dataSize);
-  return CCRC32::compute(localData.data(), localData.size());
+  if (!m_isComputedCRC32Cached)
+  {
+    uint8_t type[sizeof(m_type)];
+    m_type.to_bytes(type);
+    uint32_t crc = CCRC32::update(CCRC32::INIT, type, sizeof(type));
+    crc = CCRC32::update(crc, get_data(), m_dataSize);
+    m_computedCRC32 = crc ^ CCRC32::INIT;
+    m_isComputedCRC32Cached = true;
+  }
+  return m_computedCRC32;
 } // compute_CRC32
 
+////////////////////////////////////////////////////////////////////////////
+bool CChunk::is_CRC32_computed() const
+{
+  return m_isComputedCRC32Cached;
+} // is_CRC32_computed
+
+////////////////////////////////////////////////////////////////////////////
+void CChunk::set_computed_CRC32(const uint32_t inCRC32) const
+{
+  m_computedCRC32 = inCRC32;
+  m_isComputedCRC32Cached = true;
+} // set_computed_CRC32
+
+////////////////////////////////////////////////////////////////////////////
+void CChunk::invalidate_CRC32_cache()
+{
+  m_isComputedCRC32Cached = false;
+} // invalidate_CRC32_cache
+
 ////////////////////////////////////////////////////////////////////////////
 std::size_t CChunk::get_size() const
 {
@@ -119,24 +205,97 @@ std::size_t CChunk::get_size() const
 ////////////////////////////////////////////////////////////////////////////
 std::string CChunk::get_type() const
 {
-  std::string localTypeStr;
-  char localType[5]={0};
-  std::memcpy(localType, m_type, sizeof(m_type));
-  localTypeStr = localType;
-  return localType;
+  return m_type.to_string();
 } // get_type
 
+////////////////////////////////////////////////////////////////////////////
+CFourCC CChunk::get_fourcc() const
+{
+  return m_type;
+} // get_fourcc
+
+////////////////////////////////////////////////////////////////////////////
+const uint8_t* CChunk::get_data() const
+{
+  return m_pData;
+} // get_data
+
+////////////////////////////////////////////////////////////////////////////
+uint8_t* CChunk::get_mutable_data(CArena& ioArena)
+{
+  if (m_pSource != nullptr || m_pData == nullptr)
+  {
+    uint8_t *pOwnedData = ioArena.allocate(m_dataSize);
+    if (m_pData != nullptr)
+    {
+      std::memcpy(pOwnedData, m_pData, m_dataSize);
+    }
+    m_pData = pOwnedData;
+    m_pSource = nullptr;
+  }
+  // the caller is about to change the data
+  invalidate_CRC32_cache();
+  return const_cast<uint8_t*>(m_pData);
+} // get_mutable_data
+
+////////////////////////////////////////////////////////////////////////////
+bool CChunk::is_view() const
+{
+  return m_pSource != nullptr;
+} // is_view
+
+////////////////////////////////////////////////////////////////////////////
+const CByteBuffer* CChunk::get_source() const
+{
+  return m_pSource;
+} // get_source
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CChunk::get_source_index() const
+{
+  return (m_pData - m_pSource->get_data()) - sizeof(m_dataSize) - sizeof(m_type);
+} // get_source_index
+
+////////////////////////////////////////////////////////////////////////////
+bool CChunk::is_source_identical() const
+{
+  bool retVal = false;
+  if (m_pSource != nullptr)
+  {
+    const uint8_t *pSourceCRC = m_pData + m_dataSize;
+    uint8_t crc[sizeof(m_crc32)];
+    serialize_CRC32(crc);
+    retVal = (std::memcmp(pSourceCRC, crc, sizeof(crc)) == 0);
+  }
+  return retVal;
+} // is_source_identical
+
+////////////////////////////////////////////////////////////////////////////
+void CChunk::serialize_header(uint8_t *outpBuffer) const
+{
+  const uint32_t dataSize = swap_endian<uint32_t>(m_dataSize);
+  std::memcpy(outpBuffer, &dataSize, sizeof(dataSize));
+  m_type.to_bytes(outpBuffer + sizeof(dataSize));
+} // serialize_header
+
+////////////////////////////////////////////////////////////////////////////
+void CChunk::serialize_CRC32(uint8_t *outpBuffer) const
+{
+  const uint32_t crc = swap_endian<uint32_t>(m_crc32);
+  std::memcpy(outpBuffer, &crc, sizeof(crc));
+} // serialize_CRC32
+
 ////////////////////////////////////////////////////////////////////////////
 bool CChunk::is_valid() const
 {
-  return (get_type().size() == 4) && (compute_CRC32() == m_crc32);
+  return m_type.is_valid() && (compute_CRC32() == m_crc32);
 } // is_valid
 
 ////////////////////////////////////////////////////////////////////////////
 void CChunk::update_CRC32()
 {
   m_crc32 = compute_CRC32();
-} // is_valid
+} // update_CRC32
 
 ////////////////////////////////////////////////////////////////////////////
 std::size_t CChunk::get_header_size()
@@ -145,49 +304,51 @@ std::size_t CChunk::get_header_size()
   return HEADER_SIZE;
 } // get_header_size
 
+////////////////////////////////////////////////////////////////////////////
+bool CChunk::is_chunk_at(const uint8_t *inpBuffer, const std::size_t inBufSize, const std::size_t inIndex)
+{
+  return inIndex <= inBufSize && get_header_size() <= inBufSize - inIndex &&
+         is_chunk_header(inpBuffer + inIndex, inBufSize - inIndex);
+} // is_chunk_at
+
+////////////////////////////////////////////////////////////////////////////
+bool CChunk::is_chunk_header(const uint8_t *inpHeader, const std::size_t inMaxSize)
+{
+  // PNG sizes are limited to 2^31-1
+  constexpr uint32_t MAX_DATA_SIZE = 0x7fffffff;
+
+  const std::size_t dataSize = get_data_size(inpHeader);
+  return (inMaxSize >= get_header_size()) && (dataSize <= MAX_DATA_SIZE) && (dataSize <= inMaxSize - get_header_size()) &&
+         CFourCC::from_bytes(inpHeader + sizeof(m_dataSize)).is_valid();
+} // is_chunk_header
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CChunk::get_data_size(const uint8_t *inpHeader)
+{
+  return swap_endian<uint32_t>(*(const uint32_t*)inpHeader);
+} // get_data_size
+
 ////////////////////////////////////////////////////////////////////////////
 void CChunk::fill_end_chunk(CChunk& outEndChunk)
 {
   outEndChunk.m_dataSize = 0;
-  std::memcpy(outEndChunk.m_type, "IEND", sizeof(m_type));
-  outEndChunk.m_data.clear();
+  outEndChunk.m_type = CFourCC("IEND");
+  outEndChunk.m_pData = nullptr;
+  outEndChunk.m_pSource = nullptr;
+  outEndChunk.invalidate_CRC32_cache();
   outEndChunk.m_crc32 = outEndChunk.compute_CRC32();
 } // fill_end_chunk
 
 ////////////////////////////////////////////////////////////////////////////
 void CChunk::dump_as_header(std::ostream& oStream)
 {
-  struct SHeader
-  {
-    uint32_t m_width;
-    uint32_t m_height;
-    uint8_t  m_depth;
-    uint8_t  m_colorType;
-    uint8_t  m_compressionMethod;
-    uint8_t  m_filterMethod;
-    uint8_t  m_interlaceMethod;
-  }__attribute__((packed));
-
-  union
-  {
-    SHeader m_header;
-    uint8_t m_data[sizeof(SHeader)];
-  } header;
-
-  if (get_size() == sizeof(header))
+  SImageHeader header;
+  if (header.parse(get_data(), get_size()))
   {
-    std::memcpy(header.m_data, m_data.data(), sizeof(header));
-    oStream<<"Header:"<<std::endl;
-    oStream<<"  Width ="<<swap_endian<uint32_t>(header.m_header.m_width)<<std::endl;
-    oStream<<"  Height="<<swap_endian<uint32_t>(header.m_header.m_height)<<std::endl;
-    oStream<<"  Depth ="<<(int)header.m_header.m_depth<<std::endl;
-    oStream<<"  Color Type="<<(int)header.m_header.m_colorType<<std::endl;
-    oStream<<"  Compression Method="<<(int)header.m_header.m_compressionMethod<<std::endl;
-    oStream<<"  Filter Method="<<(int)header.m_header.m_filterMethod<<std::endl;
-    oStream<<"  Interlace Method="<<(int)header.m_header.m_interlaceMethod<<std::endl;
+    header.dump(oStream);
   }
   else
   {
-    std::cerr<<"Corrupted header found: size="<<get_size()<<" but "<<sizeof(header)<<" expected."<<std::endl;
+    std::cerr<<"Corrupted header found: size="<<get_size()<<" but "<<SImageHeader::SIZE<<" expected."<<std::endl;
   }
 } // dump_as_header
@@ -1,6 +1,12 @@
 #pragma once
 
+#include "CArena.h"
+#include "CByteBuffer.h"
+#include "CFourCC.h"
+
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <ostream>
 #include <fstream>
@@ -12,14 +18,35 @@
 // - name (4 chars)
 // - data
 // - CRC32 of the chunk and the data
+//
+// A CChunk is a compact trivially copyable descriptor: its data is either a
+// view over a source buffer or lives in an arena, and the owner of the
+// chunks (CPNG) keeps both alive. A view is copied to the arena only when
+// its data is mutated.
 class CChunk 
 {
   public:
     ////////////////////////////////////////////////////////////////////////////
-    CChunk(const std::string& inType, const std::size_t inSizeInByte);
+    // No type, no data.
+    CChunk();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Zero-filled data allocated in ioArena.
+    CChunk(const CFourCC inType, const std::size_t inSizeInByte, CArena& ioArena);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Copy of the chunk at inIndex in inData, data allocated in ioArena.
+    CChunk(const std::vector<uint8_t>& inData, const std::size_t inIndex, CArena& ioArena);
 
     ////////////////////////////////////////////////////////////////////////////
-    CChunk(const std::vector<uint8_t>& inData, const std::size_t inIndex);
+    // View of the chunk at inIndex in inSource, no data copy. inSource must
+    // outlive the chunk.
+    CChunk(const CByteBuffer& inSource, const std::size_t inIndex);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // View of the chunk at inIndex in inSource from its header and CRC bytes
+    // read apart: the data in the source is not touched.
+    CChunk(const CByteBuffer& inSource, const std::size_t inIndex, const uint8_t *inpHeader, const uint8_t *inpCRC32);
 
     ////////////////////////////////////////////////////////////////////////////
     void dump(std::ostream& ioStream, bool inOneLine = true);
@@ -31,29 +58,100 @@ class CChunk
     void dump_as_header(std::ostream& oStream);
 
     ////////////////////////////////////////////////////////////////////////////
+    // Streamed over the type then the data, memoized until they change.
     uint32_t compute_CRC32() const;
 
     ////////////////////////////////////////////////////////////////////////////
     void update_CRC32();
 
+    ////////////////////////////////////////////////////////////////////////////
+    bool is_CRC32_computed() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Memoize a CRC computed outside of the chunk (by parts, in parallel...).
+    void set_computed_CRC32(const uint32_t inCRC32) const;
+
     ////////////////////////////////////////////////////////////////////////////
     std::size_t get_size() const;
 
     ////////////////////////////////////////////////////////////////////////////
+    // For display, get_fourcc() for comparisons.
     std::string get_type() const;
 
+    ////////////////////////////////////////////////////////////////////////////
+    CFourCC get_fourcc() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    const uint8_t* get_data() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Copy the data of a view to ioArena before returning it.
+    uint8_t* get_mutable_data(CArena& ioArena);
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool is_view() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Source buffer of a view, nullptr for an owned chunk.
+    const CByteBuffer* get_source() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Index of the chunk (its size field) in the source buffer of a view.
+    std::size_t get_source_index() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // True for a view whose bytes in the source, CRC included, are exactly
+    // the ones the chunk would write.
+    bool is_source_identical() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Big endian size then type, 8 bytes.
+    void serialize_header(uint8_t *outpBuffer) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Big endian CRC32, 4 bytes.
+    void serialize_CRC32(uint8_t *outpBuffer) const;
+
     ////////////////////////////////////////////////////////////////////////////
     bool is_valid() const;
 
     ////////////////////////////////////////////////////////////////////////////
     static std::size_t get_header_size();
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Cheap structural check of the chunk at inIndex: letters only type and
+    // a size fitting in the buffer. Does not read the data.
+    static bool is_chunk_at(const uint8_t *inpBuffer, const std::size_t inBufSize, const std::size_t inIndex);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Same check on the 8 header bytes of a chunk with at most inMaxSize
+    // bytes (header and CRC included) before the end of its buffer.
+    static bool is_chunk_header(const uint8_t *inpHeader, const std::size_t inMaxSize);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Size field of the 8 header bytes of a chunk.
+    static std::size_t get_data_size(const uint8_t *inpHeader);
+
     ////////////////////////////////////////////////////////////////////////////
     static void fill_end_chunk(CChunk& outEndChunk);
 
   private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Fill size, type and CRC from the chunk at inIndex, return its data or
+    // nullptr if the chunk does not fit in the buffer.
+    const uint8_t* read_header(const uint8_t *inpBuffer, const std::size_t inBufSize, const std::size_t inIndex);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // To be called each time the type or the data change.
+    void invalidate_CRC32_cache();
+
     uint32_t             m_dataSize;
-    char                 m_type[4];
-    std::vector<uint8_t> m_data;
+    CFourCC              m_type;
     uint32_t             m_crc32;
+    mutable uint32_t     m_computedCRC32;
+    const uint8_t       *m_pData;
+    const CByteBuffer   *m_pSource;
+    mutable bool         m_isComputedCRC32Cached;
 }; // class CChunk
+
+static_assert(std::is_trivially_copyable<CChunk>::value, "CChunk must stay a plain descriptor");
@@ -0,0 +1,119 @@
+#include "CChunkIndex.h"
+
+#include <algorithm>
+
+// Offset of the first chunk, after the magic value.
+constexpr std::size_t FIRST_CHUNK_OFFSET = 8;
+
+////////////////////////////////////////////////////////////////////////////
+CChunkIndex::CChunkIndex()
+: m_nbChunks(0)
+, m_nbValidOffsets(0)
+{
+  clear();
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+void CChunkIndex::clear()
+{
+  m_chunksByType.clear();
+  m_nbChunks = 0;
+  m_offsets.assign(1, FIRST_CHUNK_OFFSET);
+  m_nbValidOffsets = 1;
+} // clear
+
+////////////////////////////////////////////////////////////////////////////
+void CChunkIndex::rebuild(const chunkContainer& inChunks)
+{
+  clear();
+  for (const auto& chunk:inChunks)
+  {
+    on_push_back(chunk);
+  }
+} // rebuild
+
+////////////////////////////////////////////////////////////////////////////
+void CChunkIndex::on_push_back(const CChunk& inChunk)
+{
+  m_chunksByType[inChunk.get_fourcc()].push_back(m_nbChunks);
+  if (m_nbValidOffsets == m_nbChunks + 1)
+  {
+    // the previous end offset is the offset of the new chunk
+    m_offsets.resize(m_nbValidOffsets + 1);
+    m_offsets[m_nbValidOffsets] = m_offsets[m_nbValidOffsets - 1] + inChunk.get_size() + CChunk::get_header_size();
+    m_nbValidOffsets++;
+  }
+  m_nbChunks++;
+} // on_push_back
+
+////////////////////////////////////////////////////////////////////////////
+void CChunkIndex::on_change(const chunkContainer& inChunks, const std::size_t inFirstPosition)
+{
+  // positions before inFirstPosition are unchanged
+  for (auto itGroup = m_chunksByType.begin(); itGroup != m_chunksByType.end(); )
+  {
+    auto& group = itGroup->second;
+    group.erase(std::lower_bound(group.begin(), group.end(), inFirstPosition), group.end());
+    itGroup = group.empty()? m_chunksByType.erase(itGroup) : std::next(itGroup);
+  }
+  for (std::size_t position = inFirstPosition; position < inChunks.size(); position++)
+  {
+    m_chunksByType[inChunks[position].get_fourcc()].push_back(position);
+  }
+
+  m_nbChunks = inChunks.size();
+  m_nbValidOffsets = std::min(m_nbValidOffsets, inFirstPosition + 1);
+} // on_change
+
+////////////////////////////////////////////////////////////////////////////
+const std::vector<std::size_t>& CChunkIndex::get_chunks(const CFourCC inType) const
+{
+  static const std::vector<std::size_t> noChunks;
+  auto itGroup = m_chunksByType.find(inType);
+  return itGroup != m_chunksByType.end()? itGroup->second : noChunks;
+} // get_chunks
+
+////////////////////////////////////////////////////////////////////////////
+std::vector<CFourCC> CChunkIndex::get_types() const
+{
+  std::vector<CFourCC> types;
+  for (const auto& group:m_chunksByType)
+  {
+    types.push_back(group.first);
+  }
+  return types;
+} // get_types
+
+////////////////////////////////////////////////////////////////////////////
+bool CChunkIndex::get_data_range(std::size_t& outFirstPosition, std::size_t& outLastPosition) const
+{
+  const auto& dataChunks = get_chunks("IDAT");
+  if (!dataChunks.empty())
+  {
+    outFirstPosition = dataChunks.front();
+    outLastPosition = dataChunks.back();
+  }
+  return !dataChunks.empty();
+} // get_data_range
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CChunkIndex::get_offset(const std::size_t inPosition, const chunkContainer& inChunks) const
+{
+  if (inPosition >= m_nbValidOffsets)
+  {
+    update_offsets(inChunks);
+  }
+  return m_offsets.at(inPosition);
+} // get_offset
+
+////////////////////////////////////////////////////////////////////////////
+void CChunkIndex::update_offsets(const chunkContainer& inChunks) const
+{
+  // resume from the last valid offset
+  m_offsets.resize(m_nbChunks + 1);
+  for (std::size_t position = m_nbValidOffsets - 1; position < m_nbChunks; position++)
+  {
+    m_offsets[position + 1] = m_offsets[position] + inChunks[position].get_size() + CChunk::get_header_size();
+  }
+  m_nbValidOffsets = m_nbChunks + 1;
+} // update_offsets
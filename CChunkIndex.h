@@ -0,0 +1,69 @@
+#pragma once
+
+#include "CChunk.h"
+
+#include <unordered_map>
+
+#if 0
+  #include <list>
+  using chunkContainer = std::list<CChunk>;
+#else
+  using chunkContainer = std::vector<CChunk>;
+#endif
+
+using chunkIterator  = chunkContainer::iterator;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Chunk positions grouped by type (in file order), IDAT run bounds and
+// cumulative byte offsets of a chunk container. Built on load then kept up
+// to date by each mutation of the container.
+class CChunkIndex
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    CChunkIndex();
+
+    ////////////////////////////////////////////////////////////////////////////
+    void clear();
+
+    ////////////////////////////////////////////////////////////////////////////
+    void rebuild(const chunkContainer& inChunks);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // inChunk has just been appended to the container.
+    void on_push_back(const CChunk& inChunk);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Chunks from inFirstPosition have been erased, inserted or moved: the
+    // positions are renumbered and the offsets after it recomputed lazily.
+    void on_change(const chunkContainer& inChunks, const std::size_t inFirstPosition);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Positions of the chunks of the given type in file order, empty if none.
+    const std::vector<std::size_t>& get_chunks(const CFourCC inType) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // All the types present.
+    std::vector<CFourCC> get_types() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Positions of the first and last IDAT.
+    bool get_data_range(std::size_t& outFirstPosition, std::size_t& outLastPosition) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Offset in the file (magic included) of the chunk at inPosition, or the
+    // file size for inPosition == number of chunks.
+    std::size_t get_offset(const std::size_t inPosition, const chunkContainer& inChunks) const;
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    void update_offsets(const chunkContainer& inChunks) const;
+
+    std::unordered_map<CFourCC, std::vector<std::size_t>>  m_chunksByType;
+    std::size_t                                            m_nbChunks;
+    // offsets are valid up to m_nbValidOffsets, recomputed lazily after
+    // the first changed chunk
+    mutable std::vector<std::size_t>                       m_offsets;
+    mutable std::size_t                                    m_nbValidOffsets;
+}; // class CChunkIndex
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "CFourCC.h"
+
+#include <array>
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Ordering constraints of the known chunk types (see the table at the top of
+// CPNG.cpp), as a range of the regions delimited by the critical chunks:
+//   IHDR | BEFORE_PALETTE | PLTE | BEFORE_DATA | IDAT... | AFTER_DATA | IEND
+// Without PLTE, BEFORE_PALETTE and BEFORE_DATA are the same place.
+class CChunkRules
+{
+  public:
+    enum class ERegion : uint8_t
+    {
+      HEADER,           // IHDR
+      BEFORE_PALETTE,
+      PALETTE,          // PLTE
+      BEFORE_DATA,
+      DATA,             // IDAT run
+      AFTER_DATA,
+      END               // IEND
+    };
+
+    struct SChunkRule
+    {
+      CFourCC m_type;
+      bool    m_isMultipleAllowed;
+      ERegion m_firstRegion;
+      ERegion m_lastRegion;
+    };
+
+    static constexpr std::array<SChunkRule, 18> RULES =
+    {{
+      {"IHDR", false, ERegion::HEADER,         ERegion::HEADER},
+      {"PLTE", false, ERegion::PALETTE,        ERegion::PALETTE},
+      {"IDAT", true,  ERegion::DATA,           ERegion::DATA},
+      {"IEND", false, ERegion::END,            ERegion::END},
+      {"cHRM", false, ERegion::BEFORE_PALETTE, ERegion::BEFORE_PALETTE},
+      {"gAMA", false, ERegion::BEFORE_PALETTE, ERegion::BEFORE_PALETTE},
+      {"sBIT", false, ERegion::BEFORE_PALETTE, ERegion::BEFORE_PALETTE},
+      {"sRGB", false, ERegion::BEFORE_PALETTE, ERegion::BEFORE_PALETTE},
+      {"iCCP", false, ERegion::BEFORE_PALETTE, ERegion::BEFORE_PALETTE},
+      {"bKGD", false, ERegion::BEFORE_DATA,    ERegion::BEFORE_DATA},
+      {"hIST", false, ERegion::BEFORE_DATA,    ERegion::BEFORE_DATA},
+      {"tRNS", false, ERegion::BEFORE_DATA,    ERegion::BEFORE_DATA},
+      {"pHYs", false, ERegion::BEFORE_PALETTE, ERegion::BEFORE_DATA},
+      {"sPLT", true,  ERegion::BEFORE_PALETTE, ERegion::BEFORE_DATA},
+      {"tIME", false, ERegion::BEFORE_PALETTE, ERegion::AFTER_DATA},
+      {"tEXt", true,  ERegion::BEFORE_PALETTE, ERegion::AFTER_DATA},
+      {"zTXt", true,  ERegion::BEFORE_PALETTE, ERegion::AFTER_DATA},
+      {"iTXt", true,  ERegion::BEFORE_PALETTE, ERegion::AFTER_DATA}
+    }};
+
+    // Unknown ancillary chunks go anywhere between the header and the end.
+    static constexpr SChunkRule UNKNOWN_RULE = {CFourCC(), true, ERegion::BEFORE_PALETTE, ERegion::AFTER_DATA};
+
+    ////////////////////////////////////////////////////////////////////////////
+    static constexpr const SChunkRule& get_rule(const CFourCC inType)
+    {
+      const SChunkRule *pRule = &UNKNOWN_RULE;
+      for (const auto& rule:RULES)
+      {
+        if (rule.m_type == inType)
+        {
+          pRule = &rule;
+          break;
+        }
+      }
+      return *pRule;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    static constexpr bool is_known(const CFourCC inType)
+    {
+      return &get_rule(inType) != &UNKNOWN_RULE;
+    }
+}; // class CChunkRules
+
+static_assert(CChunkRules::get_rule("bKGD").m_firstRegion == CChunkRules::ERegion::BEFORE_DATA &&
+              !CChunkRules::is_known("abcd"), "rule lookup");
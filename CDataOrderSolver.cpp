@@ -0,0 +1,149 @@
+#include "CDataOrderSolver.h"
+
+#include <cstring>
+#include <memory>
+
+// Live children of a node whose inflate state is kept from the parallel
+// feed, the others are fed again when their turn comes.
+constexpr std::size_t MAX_KEPT_CHILDREN = 4;
+
+////////////////////////////////////////////////////////////////////////////
+CDataOrderSolver::CDataOrderSolver(const SImageHeader& inHeader, const std::vector<std::span<const uint8_t>>& inParts,
+                                   const std::size_t inMaxNbFeeds)
+: m_header(inHeader)
+, m_parts(inParts)
+, m_twins(inParts.size())
+, m_isUsed(inParts.size(), false)
+, m_nbFeeds(0)
+, m_maxNbFeeds(inMaxNbFeeds)
+, m_isGivenUp(false)
+{
+  // equal chunks (empty ones...) are interchangeable, only one is tried
+  for (std::size_t i = 0; i < m_parts.size(); i++)
+  {
+    m_twins[i] = i;
+    for (std::size_t j = 0; m_twins[i] == i && j < i; j++)
+    {
+      if (m_parts[j].size() == m_parts[i].size() &&
+          std::memcmp(m_parts[j].data(), m_parts[i].data(), m_parts[i].size()) == 0)
+      {
+        m_twins[i] = m_twins[j];
+      }
+    }
+  }
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+bool CDataOrderSolver::solve(CThreadPool& ioPool)
+{
+  m_order.clear();
+  m_isUsed.assign(m_parts.size(), false);
+  m_nbFeeds = 0;
+  m_isGivenUp = false;
+  const CScanlineInflater root(m_header);
+  return !m_parts.empty() && search(root, ioPool);
+} // solve
+
+////////////////////////////////////////////////////////////////////////////
+bool CDataOrderSolver::search(const CScanlineInflater& inState, CThreadPool& ioPool)
+{
+  bool retVal = false;
+  if (m_order.size() == m_parts.size())
+  {
+    retVal = (inState.get_state() == CScanlineInflater::EState::DONE && inState.get_nb_trailing_bytes() == 0);
+  }
+  else if (m_nbFeeds >= m_maxNbFeeds)
+  {
+    m_isGivenUp = true;
+  }
+  else
+  {
+    // the lowest unused chunk of each group of twins
+    std::vector<std::size_t> candidates;
+    std::vector<char> isGroupTried(m_parts.size(), false);
+    for (std::size_t i = 0; i < m_parts.size(); i++)
+    {
+      if (!m_isUsed[i] && !isGroupTried[m_twins[i]])
+      {
+        isGroupTried[m_twins[i]] = true;
+        candidates.push_back(i);
+      }
+    }
+
+    // each child inflates its chunk from a copy of this state and stops at
+    // its first bad byte, the dead ones are dropped at once
+    std::vector<std::unique_ptr<CScanlineInflater>> children(candidates.size());
+    std::vector<char> isAlive(candidates.size(), false);
+    ioPool.parallel_for(candidates.size(), [&](const std::size_t inCandidate)
+                                           {
+                                             auto pChild = std::make_unique<CScanlineInflater>(inState);
+                                             pChild->feed(m_parts[candidates[inCandidate]]);
+                                             isAlive[inCandidate] = is_alive(*pChild);
+                                             if (isAlive[inCandidate])
+                                             {
+                                               children[inCandidate] = std::move(pChild);
+                                             }
+                                           });
+    m_nbFeeds += candidates.size();
+
+    // the first live children keep their state for their turn, the others
+    // are fed again: the memory along the path stays bounded
+    std::size_t nbKept = 0;
+    for (auto& pChild:children)
+    {
+      if (pChild && ++nbKept > MAX_KEPT_CHILDREN)
+      {
+        pChild.reset();
+      }
+    }
+
+    for (std::size_t i = 0; !retVal && !m_isGivenUp && i < candidates.size(); i++)
+    {
+      if (isAlive[i])
+      {
+        if (!children[i])
+        {
+          children[i] = std::make_unique<CScanlineInflater>(inState);
+          children[i]->feed(m_parts[candidates[i]]);
+          m_nbFeeds++;
+        }
+        const CScanlineInflater& child = *children[i];
+        m_order.push_back(candidates[i]);
+        m_isUsed[candidates[i]] = true;
+        retVal = search(child, ioPool);
+        if (!retVal)
+        {
+          m_isUsed[candidates[i]] = false;
+          m_order.pop_back();
+        }
+        children[i].reset();
+      }
+    }
+  }
+  return retVal;
+} // search
+
+////////////////////////////////////////////////////////////////////////////
+bool CDataOrderSolver::is_alive(const CScanlineInflater& inState)
+{
+  return inState.get_state() == CScanlineInflater::EState::RUNNING ||
+         (inState.get_state() == CScanlineInflater::EState::DONE && inState.get_nb_trailing_bytes() == 0);
+} // is_alive
+
+////////////////////////////////////////////////////////////////////////////
+const std::vector<std::size_t>& CDataOrderSolver::get_order() const
+{
+  return m_order;
+} // get_order
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CDataOrderSolver::get_nb_feeds() const
+{
+  return m_nbFeeds;
+} // get_nb_feeds
+
+////////////////////////////////////////////////////////////////////////////
+bool CDataOrderSolver::is_given_up() const
+{
+  return m_isGivenUp;
+} // is_given_up
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "CImageHeader.h"
+#include "CScanlineInflater.h"
+#include "CThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Find the order of shuffled data chunks from their content: a depth-first
+// search which extends a partial order by one chunk only while the stream
+// keeps inflating cleanly into valid scanlines (CScanlineInflater). A wrong
+// chunk breaks the deflate codes or the filter types within a few bytes, so
+// the dead branches are pruned as soon as they are fed and the search stays
+// close to n²/2 chunk feeds instead of n!.
+// The inflate state of each partial order is kept while its children are
+// tried, each child starting from a copy of it (inflateCopy): a prefix is
+// never inflated twice. The children of a node are tried in parallel on the
+// pool and the first live ones keep their state for their descent; only the
+// live children past that bound are inflated again.
+// A full order is accepted only when the stream ends on the last row of the
+// last chunk, its adler-32 included.
+// Every node scans all the chunks for its candidates, O(n) on top of its
+// feeds: fine for hundreds of chunks, not for files cut into many thousands.
+// The pruning needs rows: chunks much smaller than a row give few filter
+// bytes to check and the search may give up.
+class CDataOrderSolver
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    // inParts, the data of the chunks in file order, must outlive the
+    // solver. The search gives up after inMaxNbFeeds chunk feeds.
+    CDataOrderSolver(const SImageHeader& inHeader, const std::vector<std::span<const uint8_t>>& inParts,
+                     const std::size_t inMaxNbFeeds = 1 << 20);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // False if no order gives a sound stream, or if the search gave up.
+    bool solve(CThreadPool& ioPool);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Index in file order of the chunk for each position, as expected by
+    // CPNG::reorder_data_chunks.
+    const std::vector<std::size_t>& get_order() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Chunks fed to a copied state, the cost of the search.
+    std::size_t get_nb_feeds() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool is_given_up() const;
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Try every unused chunk after the partial order in m_order, then go
+    // down the live ones. True when m_order is complete and sound.
+    bool search(const CScanlineInflater& inState, CThreadPool& ioPool);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // A live partial order: still running, or ended without trailing bytes
+    // (empty chunks may follow).
+    static bool is_alive(const CScanlineInflater& inState);
+
+    const SImageHeader                             m_header;
+    const std::vector<std::span<const uint8_t>>&   m_parts;
+    std::vector<std::size_t>                       m_twins;     // lowest index of the chunks with the same data
+    std::vector<std::size_t>                       m_order;
+    std::vector<char>                              m_isUsed;
+    std::size_t                                    m_nbFeeds;
+    const std::size_t                              m_maxNbFeeds;
+    bool                                           m_isGivenUp;
+}; // class CDataOrderSolver
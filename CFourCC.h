@@ -0,0 +1,139 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Chunk type packed big endian in an integer: "IDAT" is 0x49444154, so the
+// integer order is the byte order and comparisons are single compares.
+// The property bits are bit 5 of each byte (lowercase letter):
+// ancillary, private, reserved, safe-to-copy.
+class CFourCC
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    constexpr CFourCC()
+      : m_value(0)
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    constexpr explicit CFourCC(const uint32_t inValue)
+      : m_value(inValue)
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // From a literal, implicit so that "IDAT" can be given for a type.
+    constexpr CFourCC(const char (&inType)[5])
+      : m_value(uint32_t(uint8_t(inType[0])) << 24 | uint32_t(uint8_t(inType[1])) << 16 |
+                uint32_t(uint8_t(inType[2])) << 8 | uint32_t(uint8_t(inType[3])))
+    {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The 4 type bytes of a chunk header.
+    static constexpr CFourCC from_bytes(const uint8_t *inpBytes)
+    {
+      return CFourCC(uint32_t(inpBytes[0]) << 24 | uint32_t(inpBytes[1]) << 16 |
+                     uint32_t(inpBytes[2]) << 8 | uint32_t(inpBytes[3]));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Null type when inType is not 4 chars long.
+    static CFourCC from_string(const std::string& inType)
+    {
+      return inType.size() == 4? from_bytes((const uint8_t*)inType.data()):CFourCC();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    constexpr void to_bytes(uint8_t *outpBytes) const
+    {
+      outpBytes[0] = uint8_t(m_value >> 24);
+      outpBytes[1] = uint8_t(m_value >> 16);
+      outpBytes[2] = uint8_t(m_value >> 8);
+      outpBytes[3] = uint8_t(m_value);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Up to the first null byte, for display.
+    std::string to_string() const
+    {
+      char type[5] = {0};
+      to_bytes((uint8_t*)type);
+      return type;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    constexpr uint32_t get_value() const
+    {
+      return m_value;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Four ASCII letters, as the format requires.
+    constexpr bool is_valid() const
+    {
+      bool retVal = true;
+      for (int shift = 0; retVal && shift < 32; shift += 8)
+      {
+        const uint8_t c = uint8_t(m_value >> shift);
+        retVal = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+      }
+      return retVal;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    constexpr bool is_critical() const
+    {
+      return (m_value & ANCILLARY_BIT) == 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    constexpr bool is_ancillary() const
+    {
+      return (m_value & ANCILLARY_BIT) != 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    constexpr bool is_private() const
+    {
+      return (m_value & PRIVATE_BIT) != 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // May be copied by an editor which does not know the type even when the
+    // critical chunks changed.
+    constexpr bool is_safe_to_copy() const
+    {
+      return (m_value & SAFE_TO_COPY_BIT) != 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    constexpr auto operator<=>(const CFourCC&) const = default;
+
+  private:
+    static constexpr uint32_t ANCILLARY_BIT    = 0x20000000;
+    static constexpr uint32_t PRIVATE_BIT      = 0x00200000;
+    static constexpr uint32_t SAFE_TO_COPY_BIT = 0x00000020;
+
+    uint32_t m_value;
+}; // class CFourCC
+
+static_assert(sizeof(CFourCC) == 4, "CFourCC must stay packed");
+static_assert(CFourCC("IDAT").get_value() == 0x49444154, "big endian packing");
+static_assert(CFourCC("IDAT").is_critical() && CFourCC("tEXt").is_ancillary() && CFourCC("tEXt").is_safe_to_copy(), "property bits");
+
+////////////////////////////////////////////////////////////////////////////////
+template <>
+struct std::hash<CFourCC>
+{
+  std::size_t operator()(const CFourCC& inType) const noexcept
+  {
+    return std::hash<uint32_t>()(inType.get_value());
+  }
+};
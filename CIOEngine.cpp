@@ -0,0 +1,231 @@
+#include "CIOEngine.h"
+#include "COutputPlan.h"
+#include "CThreadIOEngine.h"
+#ifdef WITH_LIBURING
+#include "CURingIOEngine.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////
+CIOEngine::CIOEngine()
+: m_nbPendingRequests(0)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CIOEngine::~CIOEngine()
+{
+} // destructor
+
+////////////////////////////////////////////////////////////////////////////
+void CIOEngine::submit_read(const int inFd, uint8_t *outpData, const std::size_t inSize, const off_t inOffset, completion&& inDone)
+{
+  start_request(new SRequest{false, inFd, outpData, inSize, inOffset, 0, std::move(inDone)});
+} // submit_read
+
+////////////////////////////////////////////////////////////////////////////
+void CIOEngine::submit_write(const int inFd, const uint8_t *inpData, const std::size_t inSize, const off_t inOffset, completion&& inDone)
+{
+  // the backends only read from m_pData for a write
+  start_request(new SRequest{true, inFd, const_cast<uint8_t*>(inpData), inSize, inOffset, 0, std::move(inDone)});
+} // submit_write
+
+////////////////////////////////////////////////////////////////////////////
+void CIOEngine::start_request(SRequest *inpRequest)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nbPendingRequests++;
+  }
+  submit(inpRequest);
+} // start_request
+
+////////////////////////////////////////////////////////////////////////////
+void CIOEngine::on_transfer(SRequest *inpRequest, const ssize_t inResult)
+{
+  if (inResult == -EINTR || inResult == -EAGAIN ||
+      (inResult > 0 && inpRequest->m_nbDone + inResult < inpRequest->m_size))
+  {
+    inpRequest->m_nbDone += inResult > 0? inResult:0;
+    submit(inpRequest);
+  }
+  else
+  {
+    // 0 is the end of the file for a read, and cannot progress for a write
+    const ssize_t result = (inResult < 0)? inResult :
+                           (inResult == 0 && inpRequest->m_isWrite)? -EIO : ssize_t(inpRequest->m_nbDone + inResult);
+    if (inpRequest->m_done)
+    {
+      inpRequest->m_done(result);
+    }
+    delete inpRequest;
+
+    // after the completion, which may have submitted other requests
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_nbPendingRequests == 0)
+    {
+      m_idleCondition.notify_all();
+    }
+  }
+} // on_transfer
+
+////////////////////////////////////////////////////////////////////////////
+void CIOEngine::wait_idle()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idleCondition.wait(lock, [this]() { return m_nbPendingRequests == 0; });
+} // wait_idle
+
+////////////////////////////////////////////////////////////////////////////
+void CIOEngine::read_file(const std::string& inName, std::function<void(sharedByteBuffer)>&& inDone, const std::size_t inBlockSize)
+{
+  struct SReadState
+  {
+    int                                   m_fd;
+    std::vector<uint8_t>                  m_data;
+    std::atomic<std::size_t>              m_nbRemainingBlocks;
+    std::atomic<bool>                     m_isOk;
+    std::function<void(sharedByteBuffer)> m_done;
+  };
+
+  const int fd = open(inName.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat fileStat;
+  if (fd < 0 || fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode) || fileStat.st_size == 0)
+  {
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+    inDone(CByteBuffer::load_from_file(inName));
+  }
+  else
+  {
+    const std::size_t fileSize = fileStat.st_size;
+    const std::size_t blockSize = std::max<std::size_t>(inBlockSize, 4096);
+    const std::size_t nbBlocks = (fileSize + blockSize - 1) / blockSize;
+    posix_fadvise(fd, 0, fileSize, POSIX_FADV_SEQUENTIAL);
+
+    std::shared_ptr<SReadState> pState(new SReadState);
+    pState->m_fd = fd;
+    pState->m_data.resize(fileSize);
+    pState->m_nbRemainingBlocks = nbBlocks;
+    pState->m_isOk = true;
+    pState->m_done = std::move(inDone);
+
+    for (std::size_t i = 0; i < nbBlocks; i++)
+    {
+      const std::size_t offset = i * blockSize;
+      const std::size_t size = std::min(blockSize, fileSize - offset);
+      submit_read(fd, pState->m_data.data() + offset, size, offset,
+                  [pState, size](const ssize_t inResult)
+                  {
+                    if (inResult != ssize_t(size))
+                    {
+                      pState->m_isOk = false;
+                    }
+                    if (--pState->m_nbRemainingBlocks == 0)
+                    {
+                      close(pState->m_fd);
+                      pState->m_done(pState->m_isOk? CByteBuffer::create(std::move(pState->m_data)):nullptr);
+                    }
+                  });
+    }
+  }
+} // read_file
+
+////////////////////////////////////////////////////////////////////////////
+void CIOEngine::write_file(const std::string& inName, const COutputPlan& inPlan, std::function<void(bool)>&& inDone)
+{
+  struct SWriteState
+  {
+    int                       m_fd;
+    std::atomic<std::size_t>  m_nbRemainingExtents;
+    std::atomic<bool>         m_isOk;
+    std::function<void(bool)> m_done;
+  };
+
+  const int fd = open(inName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    std::cerr<<"Cannot open '"<<inName<<"' for writing"<<std::endl;
+    inDone(false);
+  }
+  else
+  {
+    std::shared_ptr<SWriteState> pState(new SWriteState);
+    pState->m_fd = fd;
+    pState->m_nbRemainingExtents = inPlan.get_nb_extents();
+    pState->m_isOk = true;
+    pState->m_done = std::move(inDone);
+
+    // the writes are disjoint, the file size is set by the last extent
+    std::size_t offset = 0;
+    inPlan.write_to_sink([this, pState, &offset](const uint8_t *inpData, const std::size_t inSize)
+                         {
+                           submit_write(pState->m_fd, inpData, inSize, offset,
+                                        [pState, inSize](const ssize_t inResult)
+                                        {
+                                          if (inResult != ssize_t(inSize))
+                                          {
+                                            pState->m_isOk = false;
+                                          }
+                                          if (--pState->m_nbRemainingExtents == 0)
+                                          {
+                                            const bool isClosed = (close(pState->m_fd) == 0);
+                                            pState->m_done(pState->m_isOk && isClosed);
+                                          }
+                                        });
+                           offset += inSize;
+                           return true;
+                         });
+  }
+} // write_file
+
+////////////////////////////////////////////////////////////////////////////
+std::unique_ptr<CIOEngine> CIOEngine::create(const EBackend inBackend, const std::size_t inQueueDepth)
+{
+  std::unique_ptr<CIOEngine> pEngine;
+#ifdef WITH_LIBURING
+  if (inBackend != EBackend::THREADS)
+  {
+    pEngine = CURingIOEngine::create(inQueueDepth);
+  }
+#endif
+  if (!pEngine)
+  {
+    if (inBackend == EBackend::URING)
+    {
+      std::cerr<<"io_uring not available, using I/O threads"<<std::endl;
+    }
+    pEngine.reset(new CThreadIOEngine(inQueueDepth));
+  }
+  return pEngine;
+} // create
+
+////////////////////////////////////////////////////////////////////////////
+CIOEngine::EBackend CIOEngine::get_backend(const std::string& inBackendName, bool& outIsOk)
+{
+  EBackend retVal = EBackend::AUTO;
+  outIsOk = true;
+  if (inBackendName == "uring")
+  {
+    retVal = EBackend::URING;
+  }
+  else if (inBackendName == "threads")
+  {
+    retVal = EBackend::THREADS;
+  }
+  else if (inBackendName != "auto")
+  {
+    outIsOk = false;
+  }
+  return retVal;
+} // get_backend
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "CByteBuffer.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+class COutputPlan;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Asynchronous positioned reads and writes, many requests of many files in
+// flight. Completions run on an engine thread: they should only hand the
+// work over (to a CThreadPool) so the engine keeps the device busy.
+// Backends: io_uring when built with liburing, else pread/pwrite on a pool
+// of I/O threads.
+class CIOEngine
+{
+  public:
+    enum class EBackend
+    {
+      AUTO,       // io_uring if available, else threads
+      URING,
+      THREADS
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Bytes transferred (less than asked only at the end of a file) or
+    // -errno.
+    using completion = std::function<void(const ssize_t inResult)>;
+
+    ////////////////////////////////////////////////////////////////////////////
+    virtual ~CIOEngine();
+
+    ////////////////////////////////////////////////////////////////////////////
+    CIOEngine(const CIOEngine&) = delete;
+    CIOEngine& operator=(const CIOEngine&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Short transfers are resumed, the memory must stay valid until inDone.
+    void submit_read(const int inFd, uint8_t *outpData, const std::size_t inSize, const off_t inOffset, completion&& inDone);
+
+    ////////////////////////////////////////////////////////////////////////////
+    void submit_write(const int inFd, const uint8_t *inpData, const std::size_t inSize, const off_t inOffset, completion&& inDone);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Read a whole file in blocks of inBlockSize in flight together, inDone
+    // gets nullptr on error. Files which are not regular are read on the
+    // calling thread.
+    void read_file(const std::string& inName, std::function<void(sharedByteBuffer)>&& inDone, const std::size_t inBlockSize = 1 << 20);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Write every extent of the plan at its offset, all in flight together.
+    // The plan and the memory it refers to must stay valid until inDone.
+    void write_file(const std::string& inName, const COutputPlan& inPlan, std::function<void(bool)>&& inDone);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Block until every request and its completion are done, including the
+    // requests submitted by completions.
+    void wait_idle();
+
+    ////////////////////////////////////////////////////////////////////////////
+    virtual const char* get_backend_name() const = 0;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // inQueueDepth requests at most in the device queue (or I/O threads).
+    // URING falls back to THREADS when not available.
+    static std::unique_ptr<CIOEngine> create(const EBackend inBackend, const std::size_t inQueueDepth = 64);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static EBackend get_backend(const std::string& inBackendName, bool& outIsOk);
+
+  protected:
+    struct SRequest
+    {
+      bool        m_isWrite;
+      int         m_fd;
+      uint8_t    *m_pData;
+      std::size_t m_size;
+      off_t       m_offset;
+      std::size_t m_nbDone;     // transferred by the previous submissions
+      completion  m_done;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    CIOEngine();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Start one transfer of the remaining bytes, then call on_transfer.
+    virtual void submit(SRequest *inpRequest) = 0;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Resume a short transfer or complete the request and delete it.
+    void on_transfer(SRequest *inpRequest, const ssize_t inResult);
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    void start_request(SRequest *inpRequest);
+
+    std::mutex              m_mutex;
+    std::condition_variable m_idleCondition;
+    std::size_t             m_nbPendingRequests;
+}; // class CIOEngine
@@ -0,0 +1,129 @@
+#include "CImageHeader.h"
+
+#include <cstdint>
+
+namespace
+{
+// First column and row, then steps, of each Adam7 pass.
+constexpr uint8_t ADAM7[SImageHeader::NB_ADAM7_PASSES][4] =
+{
+  {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}
+};
+
+////////////////////////////////////////////////////////////////////////////
+uint32_t get_big_endian(const uint8_t *inpData)
+{
+  return (uint32_t(inpData[0]) << 24) | (uint32_t(inpData[1]) << 16) | (uint32_t(inpData[2]) << 8) | inpData[3];
+} // get_big_endian
+
+////////////////////////////////////////////////////////////////////////////
+// Samples per pixel, 0 for an unknown color type.
+std::size_t get_nb_channels(const uint8_t inColorType)
+{
+  std::size_t retVal = 0;
+  switch (inColorType)
+  {
+    case 0: retVal = 1; break;    // gray
+    case 2: retVal = 3; break;    // RGB
+    case 3: retVal = 1; break;    // palette index
+    case 4: retVal = 2; break;    // gray, alpha
+    case 6: retVal = 4; break;    // RGB, alpha
+  }
+  return retVal;
+} // get_nb_channels
+}
+
+////////////////////////////////////////////////////////////////////////////
+bool SImageHeader::parse(const uint8_t *inpData, const std::size_t inSize)
+{
+  const bool retVal = (inSize == SIZE);
+  if (retVal)
+  {
+    m_width = get_big_endian(inpData);
+    m_height = get_big_endian(inpData + 4);
+    m_depth = inpData[8];
+    m_colorType = inpData[9];
+    m_compressionMethod = inpData[10];
+    m_filterMethod = inpData[11];
+    m_interlaceMethod = inpData[12];
+  }
+  return retVal;
+} // parse
+
+////////////////////////////////////////////////////////////////////////////
+bool SImageHeader::is_valid() const
+{
+  bool isDepthOk = false;
+  switch (m_colorType)
+  {
+    case 0: isDepthOk = (m_depth == 1 || m_depth == 2 || m_depth == 4 || m_depth == 8 || m_depth == 16); break;
+    case 3: isDepthOk = (m_depth == 1 || m_depth == 2 || m_depth == 4 || m_depth == 8); break;
+    case 2:
+    case 4:
+    case 6: isDepthOk = (m_depth == 8 || m_depth == 16); break;
+  }
+  // sizes are limited to 2^31-1
+  return isDepthOk && m_width > 0 && m_height > 0 && m_width <= 0x7fffffff && m_height <= 0x7fffffff &&
+         m_compressionMethod == 0 && m_filterMethod == 0 && m_interlaceMethod <= 1;
+} // is_valid
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t SImageHeader::get_passes(std::array<SPass, NB_ADAM7_PASSES>& outPasses) const
+{
+  std::size_t nbPasses = 0;
+  if (m_interlaceMethod == 0)
+  {
+    outPasses[nbPasses++] = {get_row_size(m_width), m_height};
+  }
+  else
+  {
+    for (const auto& pass:ADAM7)
+    {
+      const std::size_t width = (m_width > pass[0])? (m_width - pass[0] + pass[2] - 1) / pass[2]:0;
+      const std::size_t height = (m_height > pass[1])? (m_height - pass[1] + pass[3] - 1) / pass[3]:0;
+      if (width > 0 && height > 0)
+      {
+        outPasses[nbPasses++] = {get_row_size(width), height};
+      }
+    }
+  }
+  return nbPasses;
+} // get_passes
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t SImageHeader::get_filtered_size() const
+{
+  std::array<SPass, NB_ADAM7_PASSES> passes;
+  const std::size_t nbPasses = get_passes(passes);
+  std::size_t retVal = 0;
+  for (std::size_t i = 0; retVal != SIZE_MAX && i < nbPasses; i++)
+  {
+    std::size_t passSize = 0;
+    if (__builtin_mul_overflow(passes[i].m_rowSize, passes[i].m_nbRows, &passSize) ||
+        __builtin_add_overflow(retVal, passSize, &retVal))
+    {
+      retVal = SIZE_MAX;
+    }
+  }
+  return retVal;
+} // get_filtered_size
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t SImageHeader::get_row_size(const std::size_t inWidth) const
+{
+  // at most 2^31 * 64 bits, no overflow
+  return 1 + (inWidth * get_nb_channels(m_colorType) * m_depth + 7) / 8;
+} // get_row_size
+
+////////////////////////////////////////////////////////////////////////////
+void SImageHeader::dump(std::ostream& oStream) const
+{
+  oStream<<"Header:"<<std::endl;
+  oStream<<"  Width ="<<m_width<<std::endl;
+  oStream<<"  Height="<<m_height<<std::endl;
+  oStream<<"  Depth ="<<(int)m_depth<<std::endl;
+  oStream<<"  Color Type="<<(int)m_colorType<<std::endl;
+  oStream<<"  Compression Method="<<(int)m_compressionMethod<<std::endl;
+  oStream<<"  Filter Method="<<(int)m_filterMethod<<std::endl;
+  oStream<<"  Interlace Method="<<(int)m_interlaceMethod<<std::endl;
+} // dump
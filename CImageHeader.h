@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// The fields of the IHDR chunk and the layout of the filtered scanlines they
+// give: one filter-type byte then the packed pixels of each row, for the
+// whole image or for each of the 7 Adam7 passes (empty passes have no row).
+struct SImageHeader
+{
+  static constexpr std::size_t SIZE = 13;
+  static constexpr std::size_t NB_ADAM7_PASSES = 7;
+
+  // Rows of one pass, filter-type byte included.
+  struct SPass
+  {
+    std::size_t m_rowSize;
+    std::size_t m_nbRows;
+  };
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  uint8_t  m_depth = 0;
+  uint8_t  m_colorType = 0;
+  uint8_t  m_compressionMethod = 0;
+  uint8_t  m_filterMethod = 0;
+  uint8_t  m_interlaceMethod = 0;
+
+  ////////////////////////////////////////////////////////////////////////////
+  // From the data of an IHDR chunk, false if it is not SIZE bytes long.
+  bool parse(const uint8_t *inpData, const std::size_t inSize);
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Sizes not null, depth allowed for the color type, known methods.
+  bool is_valid() const;
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Fill the non-empty passes in stream order and return their number, 1
+  // without interlace. For a valid header only.
+  std::size_t get_passes(std::array<SPass, NB_ADAM7_PASSES>& outPasses) const;
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Bytes of all the filtered rows, SIZE_MAX if it does not fit.
+  std::size_t get_filtered_size() const;
+
+  ////////////////////////////////////////////////////////////////////////////
+  void dump(std::ostream& oStream) const;
+
+  ////////////////////////////////////////////////////////////////////////////
+  // A row of inWidth pixels, filter-type byte included.
+  std::size_t get_row_size(const std::size_t inWidth) const;
+}; // struct SImageHeader
@@ -0,0 +1,494 @@
+#include "CInPlaceWriter.h"
+#include "CCRC32.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr char JOURNAL_MAGIC[8] = {'P', 'N', 'G', 'R', 'J', 'N', 'L', '1'};
+constexpr char JOURNAL_END_MAGIC[8] = {'C', 'O', 'M', 'P', 'L', 'E', 'T', 'E'};
+constexpr std::size_t JOURNAL_HEADER_SIZE = 8 + 8 + 8;       // magic, file size, moves
+constexpr std::size_t JOURNAL_MOVE_SIZE = 8 + 8;             // destination, size
+constexpr std::size_t JOURNAL_FOOTER_SIZE = 4 + 8;           // CRC, magic
+
+////////////////////////////////////////////////////////////////////////////
+void put_uint64(uint8_t *outpData, const uint64_t inValue)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    outpData[i] = uint8_t(inValue >> (8 * i));
+  }
+} // put_uint64
+
+////////////////////////////////////////////////////////////////////////////
+uint64_t get_uint64(const uint8_t *inpData)
+{
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--)
+  {
+    value = (value << 8) | inpData[i];
+  }
+  return value;
+} // get_uint64
+}
+
+////////////////////////////////////////////////////////////////////////////
+CInPlaceWriter::CInPlaceWriter(const std::string& inName, const EMode inMode, const std::size_t inStagingSize)
+: m_name(inName),
+  m_mode(inMode),
+  m_staging(std::max<std::size_t>(inStagingSize, 4096)),
+  m_nbBytesWritten(0)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::write(const std::vector<SMove>& inMoves)
+{
+  bool retVal = false;
+  const int fd = open(m_name.c_str(), O_RDWR | O_CLOEXEC);
+  if (fd < 0)
+  {
+    std::cerr<<"Cannot open '"<<m_name<<"': "<<std::strerror(errno)<<std::endl;
+  }
+  else if (inMoves.empty())
+  {
+    retVal = true;
+  }
+  else if (m_mode == EMode::COPY)
+  {
+    retVal = write_copy(fd, inMoves);
+  }
+  else if (m_mode == EMode::DIRECT && is_equal_size_permutation(inMoves))
+  {
+    retVal = write_cycles(fd, inMoves);
+  }
+  else if (m_mode == EMode::DIRECT)
+  {
+    // no slots to cycle through: stage the new bytes in an unlinked file
+    std::FILE *pTemporary = std::tmpfile();
+    bool isComplete = false;
+    retVal = pTemporary && write_journal(fd, fileno(pTemporary), inMoves, false) &&
+             apply_journal(fileno(pTemporary), fd, isComplete) && isComplete;
+    if (pTemporary)
+    {
+      std::fclose(pTemporary);
+    }
+  }
+  else
+  {
+    const std::string journalName = get_journal_name(m_name);
+    const int journalFd = open(journalName.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (journalFd < 0)
+    {
+      std::cerr<<"Cannot create the journal '"<<journalName<<"': "<<std::strerror(errno)
+               <<(errno == EEXIST? " (interrupted rewrite, recover it first)":"")<<std::endl;
+    }
+    else
+    {
+      // once the journal is durable the rewrite can always be completed
+      bool isComplete = false;
+      retVal = write_journal(fd, journalFd, inMoves, true) &&
+               apply_journal(journalFd, fd, isComplete) && isComplete &&
+               fdatasync(fd) == 0;
+      close(journalFd);
+      if (retVal)
+      {
+        unlink(journalName.c_str());
+        sync_parent_directory(journalName);
+      }
+    }
+  }
+
+  if (fd >= 0)
+  {
+    retVal &= (close(fd) == 0);
+  }
+  return retVal;
+} // write
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CInPlaceWriter::get_nb_bytes_written() const
+{
+  return m_nbBytesWritten;
+} // get_nb_bytes_written
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::recover(const std::string& inName)
+{
+  bool retVal = true;
+  const std::string journalName = get_journal_name(inName);
+  const int journalFd = open(journalName.c_str(), O_RDONLY | O_CLOEXEC);
+  if (journalFd >= 0)
+  {
+    const int fd = open(inName.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd >= 0)
+    {
+      // a partial journal means the file has not been touched yet
+      CInPlaceWriter writer(inName, EMode::JOURNAL);
+      bool isComplete = false;
+      retVal = writer.apply_journal(journalFd, fd, isComplete) && (!isComplete || fdatasync(fd) == 0);
+      retVal &= (close(fd) == 0);
+    }
+    else
+    {
+      std::cerr<<"Cannot open '"<<inName<<"': "<<std::strerror(errno)<<std::endl;
+      retVal = false;
+    }
+    close(journalFd);
+    if (retVal)
+    {
+      unlink(journalName.c_str());
+      sync_parent_directory(journalName);
+    }
+  }
+  return retVal;
+} // recover
+
+////////////////////////////////////////////////////////////////////////////
+std::string CInPlaceWriter::get_journal_name(const std::string& inName)
+{
+  return inName + ".reorder-journal";
+} // get_journal_name
+
+////////////////////////////////////////////////////////////////////////////
+CInPlaceWriter::EMode CInPlaceWriter::get_mode(const std::string& inModeName, bool& outIsOk)
+{
+  EMode mode = EMode::DIRECT;
+  outIsOk = true;
+  if (inModeName == "journal")
+  {
+    mode = EMode::JOURNAL;
+  }
+  else if (inModeName == "copy")
+  {
+    mode = EMode::COPY;
+  }
+  else
+  {
+    outIsOk = (inModeName == "direct");
+  }
+  return mode;
+} // get_mode
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::is_equal_size_permutation(const std::vector<SMove>& inMoves)
+{
+  bool retVal = true;
+  std::vector<std::size_t> sources;
+  std::vector<std::size_t> destinations;
+  for (const auto& move:inMoves)
+  {
+    retVal &= (move.m_size == inMoves.front().m_size);
+    sources.push_back(move.m_srcIndex);
+    destinations.push_back(move.m_dstIndex);
+  }
+  std::sort(sources.begin(), sources.end());
+  std::sort(destinations.begin(), destinations.end());
+  return retVal && sources == destinations;
+} // is_equal_size_permutation
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::write_cycles(const int inFd, const std::vector<SMove>& inMoves)
+{
+  bool retVal = true;
+  const std::size_t slotSize = inMoves.front().m_size;
+  std::unordered_map<std::size_t, std::size_t> moveByDestination;
+  for (std::size_t i = 0; i < inMoves.size(); i++)
+  {
+    moveByDestination[inMoves[i].m_dstIndex] = i;
+  }
+  m_stagingNext.resize(m_staging.size());
+
+  // the same cycles for every block of the slots, two blocks in memory
+  std::vector<bool> isMoved(inMoves.size());
+  for (std::size_t offset = 0; retVal && offset < slotSize; offset += m_staging.size())
+  {
+    const std::size_t blockSize = std::min(m_staging.size(), slotSize - offset);
+    isMoved.assign(inMoves.size(), false);
+    for (std::size_t start = 0; retVal && start < inMoves.size(); start++)
+    {
+      if (!isMoved[start])
+      {
+        // keep the bytes of the first destination, the last move reads them
+        const std::size_t cycleEnd = inMoves[start].m_dstIndex;
+        retVal = pread_all(inFd, m_staging.data(), blockSize, cycleEnd + offset);
+        std::size_t i = start;
+        while (retVal && inMoves[i].m_srcIndex != cycleEnd)
+        {
+          retVal = pread_all(inFd, m_stagingNext.data(), blockSize, inMoves[i].m_srcIndex + offset) &&
+                   pwrite_all(inFd, m_stagingNext.data(), blockSize, inMoves[i].m_dstIndex + offset);
+          isMoved[i] = true;
+          i = moveByDestination[inMoves[i].m_srcIndex];
+        }
+        retVal = retVal && pwrite_all(inFd, m_staging.data(), blockSize, inMoves[i].m_dstIndex + offset);
+        isMoved[i] = true;
+      }
+    }
+  }
+  return retVal;
+} // write_cycles
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::write_journal(const int inFd, const int inJournalFd, const std::vector<SMove>& inMoves, const bool inIsDurable)
+{
+  struct stat fileStat;
+  bool retVal = (fstat(inFd, &fileStat) == 0);
+
+  std::vector<uint8_t> header(JOURNAL_HEADER_SIZE + inMoves.size() * JOURNAL_MOVE_SIZE);
+  std::memcpy(header.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+  put_uint64(header.data() + 8, retVal? fileStat.st_size:0);
+  put_uint64(header.data() + 16, inMoves.size());
+  for (std::size_t i = 0; i < inMoves.size(); i++)
+  {
+    put_uint64(header.data() + JOURNAL_HEADER_SIZE + i * JOURNAL_MOVE_SIZE, inMoves[i].m_dstIndex);
+    put_uint64(header.data() + JOURNAL_HEADER_SIZE + i * JOURNAL_MOVE_SIZE + 8, inMoves[i].m_size);
+  }
+  uint32_t crc = CCRC32::update(CCRC32::INIT, header.data(), header.size());
+  retVal = retVal && pwrite_all(inJournalFd, header.data(), header.size(), 0);
+
+  // the file is not modified yet, the new bytes are read from it
+  std::size_t journalOffset = header.size();
+  for (std::size_t i = 0; retVal && i < inMoves.size(); i++)
+  {
+    retVal = copy_range(inFd, inMoves[i].m_srcIndex, inJournalFd, journalOffset, inMoves[i].m_size, &crc);
+    journalOffset += inMoves[i].m_size;
+  }
+
+  // the footer is written last, after the rest is durable
+  if (retVal && inIsDurable)
+  {
+    retVal = (fdatasync(inJournalFd) == 0);
+  }
+  uint8_t footer[JOURNAL_FOOTER_SIZE];
+  crc ^= CCRC32::INIT;
+  for (int i = 0; i < 4; i++)
+  {
+    footer[i] = uint8_t(crc >> (8 * i));
+  }
+  std::memcpy(footer + 4, JOURNAL_END_MAGIC, sizeof(JOURNAL_END_MAGIC));
+  retVal = retVal && pwrite_all(inJournalFd, footer, sizeof(footer), journalOffset);
+  if (retVal && inIsDurable)
+  {
+    retVal = (fdatasync(inJournalFd) == 0) && sync_parent_directory(get_journal_name(m_name));
+  }
+  if (!retVal)
+  {
+    std::cerr<<"Cannot write the journal of '"<<m_name<<"': "<<std::strerror(errno)<<std::endl;
+  }
+  return retVal;
+} // write_journal
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::apply_journal(const int inJournalFd, const int inFd, bool& outIsComplete)
+{
+  outIsComplete = false;
+  struct stat fileStat;
+  struct stat journalStat;
+  uint8_t header[JOURNAL_HEADER_SIZE];
+  bool retVal = (fstat(inFd, &fileStat) == 0) && (fstat(inJournalFd, &journalStat) == 0);
+  if (retVal && std::size_t(journalStat.st_size) >= JOURNAL_HEADER_SIZE + JOURNAL_FOOTER_SIZE &&
+      pread_all(inJournalFd, header, sizeof(header), 0) &&
+      std::memcmp(header, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+      get_uint64(header + 8) == uint64_t(fileStat.st_size))
+  {
+    const std::size_t journalSize = journalStat.st_size;
+    const std::size_t nbMoves = get_uint64(header + 16);
+    bool isSound = (nbMoves <= (journalSize - JOURNAL_HEADER_SIZE - JOURNAL_FOOTER_SIZE) / JOURNAL_MOVE_SIZE);
+    const std::size_t movesSize = isSound? nbMoves * JOURNAL_MOVE_SIZE:0;
+    std::vector<uint8_t> moves(movesSize);
+    std::size_t payloadSize = 0;
+    isSound = isSound && pread_all(inJournalFd, moves.data(), moves.size(), JOURNAL_HEADER_SIZE);
+    for (std::size_t i = 0; isSound && i < nbMoves; i++)
+    {
+      const uint64_t dstIndex = get_uint64(moves.data() + i * JOURNAL_MOVE_SIZE);
+      const uint64_t size = get_uint64(moves.data() + i * JOURNAL_MOVE_SIZE + 8);
+      isSound = (size <= std::size_t(fileStat.st_size)) && (dstIndex <= fileStat.st_size - size);
+      payloadSize += size;
+    }
+    const std::size_t payloadOffset = JOURNAL_HEADER_SIZE + movesSize;
+    isSound = isSound && (payloadOffset + payloadSize + JOURNAL_FOOTER_SIZE == journalSize);
+
+    // check everything before touching the file
+    uint8_t footer[JOURNAL_FOOTER_SIZE];
+    if (isSound && pread_all(inJournalFd, footer, sizeof(footer), payloadOffset + payloadSize) &&
+        std::memcmp(footer + 4, JOURNAL_END_MAGIC, sizeof(JOURNAL_END_MAGIC)) == 0)
+    {
+      uint32_t crc = CCRC32::update(CCRC32::INIT, header, sizeof(header));
+      crc = CCRC32::update(crc, moves.data(), moves.size());
+      for (std::size_t offset = 0; retVal && offset < payloadSize; offset += m_staging.size())
+      {
+        const std::size_t blockSize = std::min(m_staging.size(), payloadSize - offset);
+        retVal = pread_all(inJournalFd, m_staging.data(), blockSize, payloadOffset + offset);
+        crc = CCRC32::update(crc, m_staging.data(), blockSize);
+      }
+      const uint32_t journalCRC = uint32_t(get_uint64(footer) & 0xffffffff);
+      outIsComplete = retVal && (journalCRC == (crc ^ CCRC32::INIT));
+    }
+
+    std::size_t journalOffset = payloadOffset;
+    for (std::size_t i = 0; retVal && outIsComplete && i < nbMoves; i++)
+    {
+      const std::size_t dstIndex = get_uint64(moves.data() + i * JOURNAL_MOVE_SIZE);
+      const std::size_t size = get_uint64(moves.data() + i * JOURNAL_MOVE_SIZE + 8);
+      retVal = copy_range(inJournalFd, journalOffset, inFd, dstIndex, size);
+      journalOffset += size;
+    }
+  }
+  return retVal;
+} // apply_journal
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::write_copy(const int inFd, const std::vector<SMove>& inMoves)
+{
+  bool retVal = false;
+  struct stat fileStat;
+  const std::string copyName = m_name + ".reorder-tmp";
+  const int copyFd = (fstat(inFd, &fileStat) == 0)?
+                     open(copyName.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, fileStat.st_mode & 07777) : -1;
+  if (copyFd < 0)
+  {
+    std::cerr<<"Cannot create '"<<copyName<<"': "<<std::strerror(errno)<<std::endl;
+  }
+  else
+  {
+    // a reflink shares the blocks, otherwise the kernel copies them
+    retVal = (ioctl(copyFd, FICLONE, inFd) == 0);
+    if (!retVal)
+    {
+      loff_t offset = 0;
+      std::size_t remaining = fileStat.st_size;
+      while (remaining > 0)
+      {
+        const ssize_t nbCopied = copy_file_range(inFd, &offset, copyFd, nullptr, remaining, 0);
+        if (nbCopied > 0)
+        {
+          remaining -= nbCopied;
+        }
+        else if (nbCopied < 0 && errno == EINTR)
+        {
+          continue;
+        }
+        else
+        {
+          break;
+        }
+      }
+      m_nbBytesWritten += fileStat.st_size - remaining;
+      retVal = copy_range(inFd, offset, copyFd, offset, remaining);
+    }
+
+    // the file itself is not modified, the moves read it
+    for (std::size_t i = 0; retVal && i < inMoves.size(); i++)
+    {
+      retVal = copy_range(inFd, inMoves[i].m_srcIndex, copyFd, inMoves[i].m_dstIndex, inMoves[i].m_size);
+    }
+    retVal = retVal && (fsync(copyFd) == 0);
+    retVal &= (close(copyFd) == 0);
+    retVal = retVal && (rename(copyName.c_str(), m_name.c_str()) == 0) && sync_parent_directory(m_name);
+    if (!retVal)
+    {
+      std::cerr<<"Cannot replace '"<<m_name<<"': "<<std::strerror(errno)<<std::endl;
+      unlink(copyName.c_str());
+    }
+  }
+  return retVal;
+} // write_copy
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::copy_range(const int inSrcFd, std::size_t inSrcOffset, const int inDstFd, std::size_t inDstOffset,
+                                std::size_t inSize, uint32_t *ioCRC)
+{
+  bool retVal = true;
+  while (retVal && inSize > 0)
+  {
+    const std::size_t blockSize = std::min(m_staging.size(), inSize);
+    retVal = pread_all(inSrcFd, m_staging.data(), blockSize, inSrcOffset) &&
+             pwrite_all(inDstFd, m_staging.data(), blockSize, inDstOffset);
+    if (ioCRC)
+    {
+      *ioCRC = CCRC32::update(*ioCRC, m_staging.data(), blockSize);
+    }
+    inSrcOffset += blockSize;
+    inDstOffset += blockSize;
+    inSize -= blockSize;
+  }
+  return retVal;
+} // copy_range
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::pread_all(const int inFd, uint8_t *outpData, std::size_t inSize, std::size_t inOffset)
+{
+  bool retVal = true;
+  while (retVal && inSize > 0)
+  {
+    const ssize_t nbRead = pread(inFd, outpData, inSize, inOffset);
+    if (nbRead > 0)
+    {
+      outpData += nbRead;
+      inSize -= nbRead;
+      inOffset += nbRead;
+    }
+    else if (nbRead < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      // 0: unexpected end of file
+      retVal = false;
+    }
+  }
+  return retVal;
+} // pread_all
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::pwrite_all(const int inFd, const uint8_t *inpData, std::size_t inSize, std::size_t inOffset)
+{
+  bool retVal = true;
+  while (retVal && inSize > 0)
+  {
+    const ssize_t nbWritten = pwrite(inFd, inpData, inSize, inOffset);
+    if (nbWritten > 0)
+    {
+      inpData += nbWritten;
+      inSize -= nbWritten;
+      inOffset += nbWritten;
+      m_nbBytesWritten += nbWritten;
+    }
+    else if (nbWritten < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      std::cerr<<"Write error: "<<std::strerror(errno)<<std::endl;
+      retVal = false;
+    }
+  }
+  return retVal;
+} // pwrite_all
+
+////////////////////////////////////////////////////////////////////////////
+bool CInPlaceWriter::sync_parent_directory(const std::string& inName)
+{
+  const std::size_t slash = inName.rfind('/');
+  const std::string directory = (slash == std::string::npos)? ".":(slash == 0? "/":inName.substr(0, slash));
+  const int directoryFd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  bool retVal = (directoryFd >= 0);
+  if (retVal)
+  {
+    retVal = (fsync(directoryFd) == 0);
+    close(directoryFd);
+  }
+  return retVal;
+} // sync_parent_directory
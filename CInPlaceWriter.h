@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Rewrite ranges of a file with other ranges of the same file, for chunk
+// permutations that keep the file size. Only the moved bytes are written:
+// - DIRECT: pwrite in the file; equal-size slots follow the permutation
+//   cycles through a staging buffer, other layouts go through an unlinked
+//   temporary file. A crash leaves a mixed file.
+// - JOURNAL: the new bytes are written and synced to a sidecar journal
+//   first, then copied in the file. recover() replays a complete journal
+//   and drops a partial one, so the file is either old or new.
+// - COPY: reflink (or copy) the file to a temporary one, pwrite in it and
+//   rename it over the file.
+class CInPlaceWriter
+{
+  public:
+    enum class EMode
+    {
+      DIRECT,
+      JOURNAL,
+      COPY
+    };
+
+    struct SMove
+    {
+      std::size_t m_srcIndex;   // in the file before the rewrite
+      std::size_t m_dstIndex;
+      std::size_t m_size;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // inStagingSize bounds the memory used to move the bytes.
+    CInPlaceWriter(const std::string& inName, const EMode inMode, const std::size_t inStagingSize = 4 << 20);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The destinations must not overlap and hold the same bytes as the
+    // sources all together (a permutation of the moved ranges).
+    bool write(const std::vector<SMove>& inMoves);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Bytes written in the file, the journal or the copy.
+    std::size_t get_nb_bytes_written() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Finish or drop an interrupted JOURNAL rewrite of inName. Return false
+    // on I/O errors only.
+    static bool recover(const std::string& inName);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static std::string get_journal_name(const std::string& inName);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static EMode get_mode(const std::string& inModeName, bool& outIsOk);
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Every destination is the source of another move, all of the same size.
+    static bool is_equal_size_permutation(const std::vector<SMove>& inMoves);
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool write_cycles(const int inFd, const std::vector<SMove>& inMoves);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Journal: header, moves, new bytes, footer with the CRC of all of them.
+    bool write_journal(const int inFd, const int inJournalFd, const std::vector<SMove>& inMoves, const bool inIsDurable);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Copy the new bytes of a complete journal in the file. outIsComplete
+    // is false for a partial or foreign journal, which is not applied.
+    bool apply_journal(const int inJournalFd, const int inFd, bool& outIsComplete);
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool write_copy(const int inFd, const std::vector<SMove>& inMoves);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Copy inSize bytes from inSrcFd at inSrcOffset to inDstFd at
+    // inDstOffset through the staging buffer, updating ioCRC when given.
+    bool copy_range(const int inSrcFd, std::size_t inSrcOffset, const int inDstFd, std::size_t inDstOffset,
+                    std::size_t inSize, uint32_t *ioCRC = nullptr);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static bool pread_all(const int inFd, uint8_t *outpData, std::size_t inSize, std::size_t inOffset);
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool pwrite_all(const int inFd, const uint8_t *inpData, std::size_t inSize, std::size_t inOffset);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Directory entry of inName made durable.
+    static bool sync_parent_directory(const std::string& inName);
+
+    std::string          m_name;
+    EMode                m_mode;
+    std::vector<uint8_t> m_staging;
+    std::vector<uint8_t> m_stagingNext;
+    std::size_t          m_nbBytesWritten;
+}; // class CInPlaceWriter
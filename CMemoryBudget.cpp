@@ -0,0 +1,61 @@
+#include "CMemoryBudget.h"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////
+CMemoryBudget::CMemoryBudget(const std::size_t inCapacityInByte)
+: m_capacity(std::max<std::size_t>(inCapacityInByte, 1))
+, m_used(0)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+void CMemoryBudget::acquire(const std::size_t inSizeInByte)
+{
+  const std::size_t charge = get_charge(inSizeInByte);
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_releaseCondition.wait(lock, [this, charge](){ return m_used + charge <= m_capacity; });
+  m_used += charge;
+} // acquire
+
+////////////////////////////////////////////////////////////////////////////
+bool CMemoryBudget::try_acquire(const std::size_t inSizeInByte)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const bool retVal = (inSizeInByte <= m_capacity - m_used);
+  if (retVal)
+  {
+    m_used += inSizeInByte;
+  }
+  return retVal;
+} // try_acquire
+
+////////////////////////////////////////////////////////////////////////////
+void CMemoryBudget::release(const std::size_t inSizeInByte)
+{
+  const std::size_t charge = get_charge(inSizeInByte);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_used -= std::min(charge, m_used);
+  }
+  m_releaseCondition.notify_all();
+} // release
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CMemoryBudget::get_capacity() const
+{
+  return m_capacity;
+} // get_capacity
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CMemoryBudget::get_used() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_used;
+} // get_used
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CMemoryBudget::get_charge(const std::size_t inSizeInByte) const
+{
+  return std::min(inSizeInByte, m_capacity);
+} // get_charge
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Counting semaphore over bytes, bounds the memory used by work in flight.
+class CMemoryBudget
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    explicit CMemoryBudget(const std::size_t inCapacityInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Block until inSizeInByte are available. A request larger than the
+    // capacity waits for an empty budget so it can still run alone.
+    void acquire(const std::size_t inSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Take inSizeInByte if available now, never blocks: for hard caps.
+    bool try_acquire(const std::size_t inSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    void release(const std::size_t inSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t get_capacity() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t get_used() const;
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t get_charge(const std::size_t inSizeInByte) const;
+
+    const std::size_t       m_capacity;
+    std::size_t             m_used;
+    mutable std::mutex      m_mutex;
+    std::condition_variable m_releaseCondition;
+}; // class CMemoryBudget
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Caps on the memory an untrusted file may cost, checked on the size fields
+// before anything is read or allocated.
+struct SMemoryLimits
+{
+  std::size_t    m_maxChunkSize = 0x7fffffff;   // data bytes of one chunk
+  std::size_t    m_maxFileSize = SIZE_MAX;      // bytes of one file
+  CMemoryBudget *m_pProcessBudget = nullptr;    // bytes owned by all the files, nullptr: no cap
+}; // struct SMemoryLimits
@@ -0,0 +1,196 @@
+#include "COutputPlan.h"
+
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////
+COutputPlan::COutputPlan()
+: m_size(0)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+void COutputPlan::add_bytes(const uint8_t *inpData, const std::size_t inSize)
+{
+  if (!m_extents.empty() && m_extents.back().m_kind == EExtentKind::BYTES)
+  {
+    m_extents.back().m_size += inSize;
+  }
+  else
+  {
+    m_extents.push_back({EExtentKind::BYTES, nullptr, nullptr, m_bytes.size(), inSize});
+  }
+  m_bytes.insert(m_bytes.end(), inpData, inpData + inSize);
+  m_size += inSize;
+} // add_bytes
+
+////////////////////////////////////////////////////////////////////////////
+void COutputPlan::add_memory(const uint8_t *inpData, const std::size_t inSize)
+{
+  m_extents.push_back({EExtentKind::MEMORY, nullptr, inpData, 0, inSize});
+  m_size += inSize;
+} // add_memory
+
+////////////////////////////////////////////////////////////////////////////
+void COutputPlan::add_source_range(const CByteBuffer& inSource, const std::size_t inIndex, const std::size_t inSize)
+{
+  if (!m_extents.empty() && m_extents.back().m_kind == EExtentKind::SOURCE &&
+      m_extents.back().m_pSource == &inSource && m_extents.back().m_index + m_extents.back().m_size == inIndex)
+  {
+    m_extents.back().m_size += inSize;
+  }
+  else
+  {
+    m_extents.push_back({EExtentKind::SOURCE, &inSource, nullptr, inIndex, inSize});
+  }
+  m_size += inSize;
+} // add_source_range
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t COutputPlan::get_size() const
+{
+  return m_size;
+} // get_size
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t COutputPlan::get_nb_extents() const
+{
+  return m_extents.size();
+} // get_nb_extents
+
+////////////////////////////////////////////////////////////////////////////
+bool COutputPlan::write_to_file(const std::string& inName) const
+{
+  bool retVal = false;
+  const int fd = open(inName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd >= 0)
+  {
+    retVal = write_to_fd(fd);
+    retVal &= (close(fd) == 0);
+  }
+  else
+  {
+    std::cerr<<"Cannot open '"<<inName<<"': "<<std::strerror(errno)<<std::endl;
+  }
+  return retVal;
+} // write_to_file
+
+////////////////////////////////////////////////////////////////////////////
+bool COutputPlan::write_to_fd(const int inFd) const
+{
+  bool retVal = true;
+  for (auto it = m_extents.begin(); retVal && it != m_extents.end(); ++it)
+  {
+    if (it->m_kind == EExtentKind::SOURCE && it->m_pSource->get_file_descriptor() >= 0)
+    {
+      retVal = copy_source_range(*it, inFd);
+    }
+    else
+    {
+      retVal = write_all(inFd, get_extent_data(*it), it->m_size);
+    }
+  }
+  return retVal;
+} // write_to_fd
+
+////////////////////////////////////////////////////////////////////////////
+bool COutputPlan::write_to_sink(const std::function<bool(const uint8_t*, std::size_t)>& inSink) const
+{
+  bool retVal = true;
+  for (auto it = m_extents.begin(); retVal && it != m_extents.end(); ++it)
+  {
+    retVal = inSink(get_extent_data(*it), it->m_size);
+  }
+  return retVal;
+} // write_to_sink
+
+////////////////////////////////////////////////////////////////////////////
+const uint8_t* COutputPlan::get_extent_data(const SExtent& inExtent) const
+{
+  const uint8_t *pData = nullptr;
+  switch (inExtent.m_kind)
+  {
+    case EExtentKind::BYTES:  pData = m_bytes.data() + inExtent.m_index; break;
+    case EExtentKind::MEMORY: pData = inExtent.m_pData; break;
+    case EExtentKind::SOURCE: pData = inExtent.m_pSource->get_data() + inExtent.m_index; break;
+  }
+  return pData;
+} // get_extent_data
+
+////////////////////////////////////////////////////////////////////////////
+bool COutputPlan::copy_source_range(const SExtent& inExtent, const int inFd) const
+{
+  const int sourceFd = inExtent.m_pSource->get_file_descriptor();
+  loff_t offset = inExtent.m_index;
+  std::size_t remaining = inExtent.m_size;
+
+  // copy_file_range: no user space buffer, reflinks on some filesystems
+  while (remaining > 0)
+  {
+    const ssize_t nbCopied = copy_file_range(sourceFd, &offset, inFd, nullptr, remaining, 0);
+    if (nbCopied > 0)
+    {
+      remaining -= nbCopied;
+    }
+    else if (nbCopied < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  // sendfile: cross filesystem copies on older kernels
+  while (remaining > 0)
+  {
+    off_t sendOffset = offset;
+    const ssize_t nbSent = sendfile(inFd, sourceFd, &sendOffset, remaining);
+    if (nbSent > 0)
+    {
+      offset = sendOffset;
+      remaining -= nbSent;
+    }
+    else if (nbSent < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  // plain write from the mapping
+  return (remaining == 0) || write_all(inFd, inExtent.m_pSource->get_data() + offset, remaining);
+} // copy_source_range
+
+////////////////////////////////////////////////////////////////////////////
+bool COutputPlan::write_all(const int inFd, const uint8_t *inpData, std::size_t inSize)
+{
+  bool retVal = true;
+  while (retVal && inSize > 0)
+  {
+    const ssize_t nbWritten = write(inFd, inpData, inSize);
+    if (nbWritten > 0)
+    {
+      inpData += nbWritten;
+      inSize -= nbWritten;
+    }
+    else if (nbWritten < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      std::cerr<<"Write error: "<<std::strerror(errno)<<std::endl;
+      retVal = false;
+    }
+  }
+  return retVal;
+} // write_all
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CByteBuffer.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Output file described as a sequence of extents: small synthesized pieces
+// (magic, rebuilt headers and CRCs), in-memory ranges and ranges of source
+// buffers. Adjacent source ranges are merged so an unmodified run of chunks
+// is a single kernel-side copy.
+class COutputPlan
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    COutputPlan();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The bytes are copied in the plan, for small pieces only.
+    void add_bytes(const uint8_t *inpData, const std::size_t inSize);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The memory must stay valid until the plan is written.
+    void add_memory(const uint8_t *inpData, const std::size_t inSize);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The source must stay alive until the plan is written.
+    void add_source_range(const CByteBuffer& inSource, const std::size_t inIndex, const std::size_t inSize);
+
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t get_size() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t get_nb_extents() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool write_to_file(const std::string& inName) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Write at the current offset of inFd.
+    bool write_to_fd(const int inFd) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // One call per extent, in order, until inSink returns false.
+    bool write_to_sink(const std::function<bool(const uint8_t*, std::size_t)>& inSink) const;
+
+  private:
+    enum class EExtentKind
+    {
+      BYTES,
+      MEMORY,
+      SOURCE
+    };
+
+    struct SExtent
+    {
+      EExtentKind        m_kind;
+      const CByteBuffer *m_pSource;
+      const uint8_t     *m_pData;
+      std::size_t        m_index;
+      std::size_t        m_size;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    const uint8_t* get_extent_data(const SExtent& inExtent) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // copy_file_range, then sendfile, then a plain write from the mapping.
+    bool copy_source_range(const SExtent& inExtent, const int inFd) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    static bool write_all(const int inFd, const uint8_t *inpData, std::size_t inSize);
+
+    std::vector<SExtent> m_extents;
+    std::vector<uint8_t> m_bytes;
+    std::size_t          m_size;
+}; // class COutputPlan
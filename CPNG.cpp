@@ -1,12 +1,23 @@
 #include "CPNG.h"
+#include "CCRC32.h"
+#include "CChunkRules.h"
+#include "CDataOrderSolver.h"
+#include "CImageHeader.h"
+#include "CScanlineInflater.h"
+#include "CZlib.h"
 
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <exception>
 #include <algorithm>
+#include <array>
 #include <functional>
 #include <iomanip>
+#include <cstring>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /*
    Critical chunks (must appear in this order, except PLTE
@@ -37,10 +48,15 @@
            zTXt    Yes     None
 */
 
+// Work unit of the parallel CRC verification.
+constexpr std::size_t VERIFY_UNIT_SIZE = 1 << 20;
+
+// Largest chunk data size allowed by the format (2^31 - 1).
+constexpr std::size_t MAX_CHUNK_SIZE = 0x7fffffff;
+
 constexpr uint8_t PNG_MAGIC_VALUE[]={0x89,0x50,0x4e,0x47,0x0d,0x0a,0x1a,0x0a};
 constexpr std::size_t SIZE_OF_PNG_MAGIC_VALUE=sizeof(PNG_MAGIC_VALUE);
 
-const std::vector<std::string> CHUNK_TYPES = {"IHDR", "PLTE", "sRGB", "cHRM", "gAMA", "sBIT", "bKGD", "hIST", "tRNS", "pHYs", "tIME", "tEXt", "zTXt", "IDAT", "IEND"};
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -50,37 +66,112 @@ CPNG::CPNG()
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-bool CPNG::load_from_PNG(const std::string& inName)
+CPNG::~CPNG()
 {
-  bool retVal = false;
-  std::ifstream pngFile(inName, std::ifstream::binary);
-  if (pngFile)
+  if (m_limits.m_pProcessBudget != nullptr)
   {
-    // get the size of the file
-    pngFile.seekg (0, pngFile.end);
-    const std::size_t fileSize = pngFile.tellg();
-    pngFile.seekg (0, pngFile.beg);
+    m_limits.m_pProcessBudget->release(m_nbChargedBytes);
+  }
+} // destructor
 
-    std::vector<uint8_t> pngData;
-    pngData.resize(fileSize);
-    pngFile.read ((char*)pngData.data(), pngData.size());
-    pngFile.close();
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void CPNG::set_memory_limits(const SMemoryLimits& inLimits)
+{
+  m_limits = inLimits;
+} // set_memory_limits
 
-    if (fileSize > SIZE_OF_PNG_MAGIC_VALUE)
-    {
-      // Magic check
-      bool magicCheck = (PNG_MAGIC_VALUE[0] == pngData.at(0));
-      for (std::size_t i = 1; magicCheck && i < SIZE_OF_PNG_MAGIC_VALUE; i++)
-      {
-        magicCheck &= (PNG_MAGIC_VALUE[i] == pngData.at(i));
-      }
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const CPNG::SError& CPNG::get_last_error() const
+{
+  return m_lastError;
+} // get_last_error
 
-      if (magicCheck)
-      {
-        const size_t nbChunks = load_chunks_from_buffer(pngData, SIZE_OF_PNG_MAGIC_VALUE);
-        retVal = (nbChunks > 0);
-      }
-    }
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::string CPNG::SError::get_message() const
+{
+  std::string retVal;
+  switch (m_code)
+  {
+    case ECode::NONE:
+      break;
+    case ECode::CANNOT_READ:
+      retVal = "cannot read";
+      break;
+    case ECode::NOT_A_PNG:
+      retVal = "not a png";
+      break;
+    case ECode::FILE_TOO_LARGE:
+      retVal = "file too large (" + std::to_string(m_size) + " bytes)";
+      break;
+    case ECode::CHUNK_TOO_LARGE:
+      retVal = "chunk too large (" + m_type.to_string() + " of " + std::to_string(m_size) + " bytes at " + std::to_string(m_offset) + ")";
+      break;
+    case ECode::OUT_OF_BUDGET:
+      retVal = "out of memory budget (" + std::to_string(m_size) + " bytes more)";
+      break;
+  }
+  return retVal;
+} // get_message
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::string CPNG::SDataCheck::get_message() const
+{
+  std::string retVal;
+  switch (m_result)
+  {
+    case EResult::SOUND:
+      retVal = "sound";
+      break;
+    case EResult::NO_HEADER:
+      retVal = "no valid header";
+      break;
+    case EResult::NO_DATA:
+      retVal = "no data";
+      break;
+    case EResult::NOT_CONSECUTIVE:
+      retVal = "data chunks are not consecutive";
+      break;
+    case EResult::BAD_STREAM:
+      retVal = "damaged stream after " + std::to_string(m_nbBytes) + " bytes";
+      break;
+    case EResult::BAD_FILTER:
+      retVal = "bad filter type at byte " + std::to_string(m_nbBytes);
+      break;
+    case EResult::TOO_SHORT:
+      retVal = "stream too short (" + std::to_string(m_nbBytes) + " of " + std::to_string(m_expectedSize) + " bytes)";
+      break;
+    case EResult::TOO_LONG:
+      retVal = "stream too long (more than " + std::to_string(m_expectedSize) + " bytes)";
+      break;
+  }
+  if (m_nbTrailingBytes > 0)
+  {
+    retVal += ", " + std::to_string(m_nbTrailingBytes) + " trailing bytes";
+  }
+  return retVal;
+} // get_message
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CPNG::load_from_PNG(const std::string& inName)
+{
+  bool retVal = false;
+  sharedByteBuffer pPngData;
+  {
+    CScopedPhase phase(get_stats(), SStats::EPhase::READ);
+    pPngData = CByteBuffer::load_from_file(inName, true, m_limits.m_maxFileSize);
+  }
+  if (pPngData)
+  {
+    retVal = load_from_buffer(pPngData);
+  }
+  else
+  {
+    set_read_error(inName);
   }
 
   return retVal;
@@ -88,279 +179,1423 @@ bool CPNG::load_from_PNG(const std::string& inName)
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-bool CPNG::save_to_PNG(const std::string& inName)
+bool CPNG::load_lazily_from_PNG(const std::string& inName)
 {
   bool retVal = false;
-  std::ofstream pngFile(inName, std::ofstream::binary);
-  if (pngFile)
+  sharedByteBuffer pPngData;
   {
-    try
-    {
-      pngFile.write((const char*)PNG_MAGIC_VALUE, SIZE_OF_PNG_MAGIC_VALUE);
+    CScopedPhase phase(get_stats(), SStats::EPhase::READ);
+    pPngData = CByteBuffer::load_from_file(inName, false, m_limits.m_maxFileSize);
+  }
 
-      for (auto chunk:m_chunks)
+  m_lastError = SError();
+  if (!pPngData)
+  {
+    set_read_error(inName);
+  }
+  else if (!pPngData->is_mapped())
+  {
+    // read in full anyway
+    retVal = load_from_buffer(pPngData);
+  }
+  else
+  {
+    SStats *pStats = get_stats();
+    CScopedPhase phase(pStats, SStats::EPhase::SCAN);
+    const std::size_t fileSize = pPngData->get_size();
+    std::size_t nbBytesRead = SIZE_OF_PNG_MAGIC_VALUE;
+    uint8_t magic[SIZE_OF_PNG_MAGIC_VALUE];
+    if (pPngData->read_at(0, magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), PNG_MAGIC_VALUE))
+    {
+      // the CRC of a chunk then the header of the next one, in one read
+      uint8_t buffer[12];
+      std::size_t index = SIZE_OF_PNG_MAGIC_VALUE;
+      bool isSound = pPngData->read_at(index, buffer + 4, 8) && CChunk::is_chunk_header(buffer + 4, fileSize - index);
+      nbBytesRead += 8;
+      while (isSound)
       {
-        if (chunk.is_valid())
+        uint8_t header[8];
+        std::memcpy(header, buffer + 4, sizeof(header));
+        if (CChunk::get_data_size(header) > m_limits.m_maxChunkSize)
+        {
+          // a sound header over the cap stops the load, no resync
+          m_lastError = {SError::ECode::CHUNK_TOO_LARGE, index, CFourCC::from_bytes(header + 4), CChunk::get_data_size(header)};
+          break;
+        }
+        const std::size_t nextIndex = index + CChunk::get_header_size() + CChunk::get_data_size(header);
+        const std::size_t readSize = std::min(sizeof(buffer), fileSize - nextIndex + 4);
+        isSound = pPngData->read_at(nextIndex - 4, buffer, readSize);
+        nbBytesRead += readSize;
+        const bool isNextSound = isSound && readSize == sizeof(buffer) && CChunk::is_chunk_header(buffer + 4, fileSize - nextIndex);
+        if (isSound && (nextIndex == fileSize || isNextSound))
         {
-          chunk.dump(pngFile);
+          m_chunks.emplace_back(*pPngData, index, header, buffer);
+          m_index.on_push_back(m_chunks.back());
+          if (pStats)
+          {
+            pStats->m_nbChunksByType[m_chunks.back().get_fourcc()]++;
+          }
+          index = nextIndex;
         }
+        isSound = isNextSound;
       }
-      retVal = true;
+
+      if (index < fileSize && m_lastError.m_code == SError::ECode::NONE)
+      {
+        // damaged: the regular parser resynchronizes from there, reading
+        // the rest of the file
+        load_chunks_from_buffer(pPngData, index);
+        nbBytesRead += fileSize - index;
+      }
+      else
+      {
+        m_sources.push_back(pPngData);
+      }
+      retVal = !m_chunks.empty() && m_lastError.m_code == SError::ECode::NONE;
     }
-    catch (std::exception& inEx)
+    else
+    {
+      m_lastError.m_code = SError::ECode::NOT_A_PNG;
+    }
+
+    if (pStats)
     {
-      std::cerr<<"Error on save_to_PNG: "<<inEx.what()<<std::endl;
+      pStats->m_nbBytesRead += nbBytesRead;
+      pStats->m_nbFiles++;
     }
   }
 
   return retVal;
-} // save_to_PNG
+} // load_lazily_from_PNG
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void CPNG::dump_chunks(std::ostream& ioStream, bool inOneLine)
+bool CPNG::load_from_memory(std::span<const std::byte> inData)
 {
-  std::size_t id = 0;
-  for (auto chunk:m_chunks)
-  {
-    if (chunk.is_valid())
-    {
-      ioStream << std::setw(3) << id++ << " # ";
-      chunk.dump(ioStream, inOneLine);
-    }
-  }
-} // dump_chunks
+  return load_from_buffer(CByteBuffer::create_view((const uint8_t*)inData.data(), inData.size()));
+} // load_from_memory
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-std::size_t CPNG::load_chunks_from_buffer(const std::vector<uint8_t>& inBufData, const std::size_t inIndex)
+bool CPNG::load_from_buffer(const sharedByteBuffer& inpPngData)
 {
-  std::size_t nbChunkRead = 0;
+  bool retVal = false;
+  if (SStats *pStats = get_stats())
+  {
+    pStats->m_nbBytesRead += inpPngData->get_size();
+    pStats->m_nbFiles++;
+  }
+  const uint8_t *pData = inpPngData->get_data();
+  const std::size_t fileSize = inpPngData->get_size();
 
-  const std::size_t fileSize = inBufData.size();
-  std::size_t index = find_next_chunk(inBufData, inIndex);
+  m_lastError = SError();
+  if (fileSize > m_limits.m_maxFileSize)
+  {
+    m_lastError = {SError::ECode::FILE_TOO_LARGE, 0, CFourCC(), fileSize};
+  }
+  else if (fileSize > SIZE_OF_PNG_MAGIC_VALUE && (!inpPngData->is_owned() || charge_memory(fileSize)))
+  {
+    // Magic check
+    bool magicCheck = (PNG_MAGIC_VALUE[0] == pData[0]);
+    for (std::size_t i = 1; magicCheck && i < SIZE_OF_PNG_MAGIC_VALUE; i++)
+    {
+      magicCheck &= (PNG_MAGIC_VALUE[i] == pData[i]);
+    }
 
-  while ( index < fileSize )
+    if (magicCheck)
+    {
+      const size_t nbChunks = load_chunks_from_buffer(inpPngData, SIZE_OF_PNG_MAGIC_VALUE);
+      retVal = (nbChunks > 0) && m_lastError.m_code == SError::ECode::NONE;
+    }
+    else
+    {
+      m_lastError.m_code = SError::ECode::NOT_A_PNG;
+    }
+  }
+  else if (m_lastError.m_code == SError::ECode::NONE)
   {
-    m_chunks.emplace_back(inBufData, index);
-    index = find_next_chunk(inBufData, index + m_chunks.back().get_size()+CChunk::get_header_size());
-    nbChunkRead++;
+    m_lastError.m_code = SError::ECode::NOT_A_PNG;
   }
 
-  return nbChunkRead;
-} // load_chunks_from_buffer
+  return retVal;
+} // load_from_buffer
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-std::size_t CPNG::load_chunks_from_file(const std::string& inName, const std::size_t inIndex)
+bool CPNG::save_to_PNG(const std::string& inName, const ESaveMode inMode, CThreadPool& ioPool)
 {
-  std::size_t nbChunkRead = 0;
-  std::ifstream dataFile(inName, std::ifstream::binary);
-  if (dataFile)
+  bool retVal = false;
+  // invalid chunks are not saved
+  verify_chunks(ioPool);
+  CScopedPhase phase(get_stats(), SStats::EPhase::WRITE);
+  std::size_t nbBytesWritten = 0;
+  const std::string temporaryName = get_temporary_output_name(inName);
+  const std::string& outName = temporaryName.empty()? inName:temporaryName;
+  if (inMode == ESaveMode::EXTENTS)
+  {
+    COutputPlan plan;
+    build_output_plan(plan, ioPool);
+    retVal = plan.write_to_file(outName);
+    nbBytesWritten = retVal? plan.get_size():0;
+  }
+  else
   {
-    // get the size of the file
-    dataFile.seekg (0, dataFile.end);
-    const std::size_t fileSize = dataFile.tellg();
-    dataFile.seekg (0, dataFile.beg);
+    std::ofstream pngFile(outName, std::ofstream::binary);
+    if (pngFile)
+    {
+      try
+      {
+        pngFile.write((const char*)PNG_MAGIC_VALUE, SIZE_OF_PNG_MAGIC_VALUE);
+
+        for (auto& chunk:m_chunks)
+        {
+          if (chunk.is_valid())
+          {
+            chunk.dump(pngFile);
+          }
+        }
+        nbBytesWritten = pngFile.tellp();
+        pngFile.close();
+        retVal = !pngFile.fail();
+      }
+      catch (std::exception& inEx)
+      {
+        std::cerr<<"Error on save_to_PNG: "<<inEx.what()<<std::endl;
+      }
+    }
+  }
 
-    std::vector<uint8_t> bufData;
-    bufData.resize(fileSize);
-    dataFile.read ((char*)bufData.data(), bufData.size());
-    dataFile.close();
+  // the source stays mapped through its old inode
+  struct stat inputStat;
+  if (retVal && !temporaryName.empty())
+  {
+    retVal = (stat(inName.c_str(), &inputStat) == 0) && (chmod(temporaryName.c_str(), inputStat.st_mode & 07777) == 0) &&
+             (rename(temporaryName.c_str(), inName.c_str()) == 0);
+  }
+  if (!retVal)
+  {
+    std::cerr<<"Error on save_to_PNG: cannot write '"<<inName<<"'"<<std::endl;
+    if (!temporaryName.empty())
+    {
+      unlink(temporaryName.c_str());
+    }
+    nbBytesWritten = 0;
+  }
 
-    nbChunkRead = load_chunks_from_buffer(bufData, inIndex);
+  if (SStats *pStats = get_stats())
+  {
+    pStats->m_nbBytesWritten += nbBytesWritten;
+    record_payload_memory();
   }
 
-  return nbChunkRead;
-} // load_chunks_from_file
+  return retVal;
+} // save_to_PNG
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-std::size_t CPNG::find_next_chunk(const std::vector<uint8_t>& inBufData, std::size_t inIndex)
+void CPNG::save_to_PNG(const std::string& inName, CIOEngine& ioEngine, std::function<void(bool)>&& inDone,
+                       CThreadPool& ioPool)
 {
-  std::size_t chunkIndex = std::numeric_limits<std::size_t>::max();
-  auto fistIndex = inBufData.begin() + inIndex;
-  for (const auto& chunkType:CHUNK_TYPES)
+  std::shared_ptr<COutputPlan> pPlan(new COutputPlan);
+  build_output_plan(*pPlan, ioPool);
+  if (SStats *pStats = get_stats())
   {
-    auto it = std::search(fistIndex, inBufData.end(), std::boyer_moore_searcher(chunkType.begin(), chunkType.end()));
-    if (it != inBufData.end())
-    {
-      chunkIndex = it - inBufData.begin() - sizeof(uint32_t);
-      break;
-    }
+    // counted when queued: the stats may not outlive the writes
+    pStats->m_nbBytesWritten += pPlan->get_size();
+    record_payload_memory();
   }
+  const std::string temporaryName = get_temporary_output_name(inName);
+  ioEngine.write_file(temporaryName.empty()? inName:temporaryName, *pPlan,
+                      [pPlan, inName, temporaryName, done = std::move(inDone)](const bool inIsOk)
+                      {
+                        bool isOk = inIsOk;
+                        struct stat inputStat;
+                        if (isOk && !temporaryName.empty())
+                        {
+                          isOk = (stat(inName.c_str(), &inputStat) == 0) && (chmod(temporaryName.c_str(), inputStat.st_mode & 07777) == 0) &&
+                                 (rename(temporaryName.c_str(), inName.c_str()) == 0);
+                        }
+                        if (!isOk)
+                        {
+                          std::cerr<<"Error on save_to_PNG: cannot write '"<<inName<<"'"<<std::endl;
+                          if (!temporaryName.empty())
+                          {
+                            unlink(temporaryName.c_str());
+                          }
+                        }
+                        done(isOk);
+                      });
+} // save_to_PNG
 
-  return std::min(chunkIndex, inBufData.size());
-} // find_next_chunk
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::size_t CPNG::get_saved_size(CThreadPool& ioPool)
+{
+  verify_chunks(ioPool);
+  std::size_t retVal = SIZE_OF_PNG_MAGIC_VALUE;
+  for (const auto& chunk:m_chunks)
+  {
+    retVal += chunk.is_valid()? chunk.get_size() + CChunk::get_header_size():0;
+  }
+  return retVal;
+} // get_saved_size
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-bool CPNG::get_data_range(chunkIterator& outFirstIt, chunkIterator& outLastIt)
+std::size_t CPNG::save_to_memory(std::span<std::byte> outBuffer, CThreadPool& ioPool)
 {
-  chunkContainer chunkToSearch;
-  chunkToSearch.emplace_back("IDAT", 0);
-  
-  outFirstIt = std::find_first_of(m_chunks.begin(), m_chunks.end(), chunkToSearch.begin(), chunkToSearch.end(),
-                         [](const CChunk& inC1, const CChunk& inC2){ return inC1.get_type() == inC2.get_type(); } );
-  outLastIt = std::find_end(m_chunks.begin(), m_chunks.end(), chunkToSearch.begin(), chunkToSearch.end(),
-                         [](const CChunk& inC1, const CChunk& inC2){ return inC1.get_type() == inC2.get_type(); } );
+  std::size_t retVal = 0;
+  COutputPlan plan;
+  build_output_plan(plan, ioPool);
+  CScopedPhase phase(get_stats(), SStats::EPhase::WRITE);
+  if (plan.get_size() <= outBuffer.size())
+  {
+    std::byte *pOutput = outBuffer.data();
+    plan.write_to_sink([&pOutput](const uint8_t *inpData, const std::size_t inSize)
+                       {
+                         std::memcpy(pOutput, inpData, inSize);
+                         pOutput += inSize;
+                         return true;
+                       });
+    retVal = plan.get_size();
+  }
+  else
+  {
+    std::cerr<<"Error on save_to_memory: "<<plan.get_size()<<" bytes needed, "<<outBuffer.size()<<" given"<<std::endl;
+  }
 
-  return outFirstIt != m_chunks.end() && outLastIt != m_chunks.end();
-}  // get_data_range
+  if (SStats *pStats = get_stats())
+  {
+    pStats->m_nbBytesWritten += retVal;
+  }
+  return retVal;
+} // save_to_memory
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void CPNG::reorder_data_chunks(const std::vector<std::size_t>& inNewOrder)
+bool CPNG::save_to_sink(const sinkFunction& inSink, CThreadPool& ioPool)
 {
-  chunkIterator firstIt;
-  chunkIterator lastIt;
-  if (get_data_range(firstIt, lastIt))
+  COutputPlan plan;
+  build_output_plan(plan, ioPool);
+  CScopedPhase phase(get_stats(), SStats::EPhase::WRITE);
+  const bool retVal = plan.write_to_sink([&inSink](const uint8_t *inpData, const std::size_t inSize)
+                                         {
+                                           return inSink(std::span<const std::byte>((const std::byte*)inpData, inSize));
+                                         });
+  if (SStats *pStats = get_stats())
   {
-    // std::cout<<"Range: "<<std::distance(m_chunks.begin(), firstIt)<<" "<<std::distance(m_chunks.begin(), lastIt)<<std::endl;
-    lastIt++;
-    std::vector<CChunk> dataChunks( firstIt, lastIt);
+    pStats->m_nbBytesWritten += retVal? plan.get_size():0;
+  }
+  return retVal;
+} // save_to_sink
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CPNG::save_in_place(const std::string& inName, const CInPlaceWriter::EMode inMode, CThreadPool& ioPool)
+{
+  bool retVal = false;
+  verify_chunks(ioPool);
+  CScopedPhase phase(get_stats(), SStats::EPhase::WRITE);
 
-    if (inNewOrder.size() != dataChunks.size())
+  // the file must be the single source, chunks unmodified and all kept
+  struct stat fileStat;
+  struct stat sourceStat;
+  const CByteBuffer *pSource = (m_sources.size() == 1)? m_sources.front().get():nullptr;
+  bool isInPlace = pSource && pSource->get_file_descriptor() >= 0 &&
+                   stat(inName.c_str(), &fileStat) == 0 && fstat(pSource->get_file_descriptor(), &sourceStat) == 0 &&
+                   fileStat.st_dev == sourceStat.st_dev && fileStat.st_ino == sourceStat.st_ino;
+  std::vector<CInPlaceWriter::SMove> moves;
+  std::size_t offset = SIZE_OF_PNG_MAGIC_VALUE;
+  for (auto it = m_chunks.begin(); isInPlace && it != m_chunks.end(); ++it)
+  {
+    isInPlace = it->is_valid() && it->is_source_identical() && it->get_source() == pSource;
+    const std::size_t size = it->get_size() + CChunk::get_header_size();
+    if (isInPlace && it->get_source_index() != offset)
     {
-      std::cerr<<"Wrong number of chunks: "<<inNewOrder.size()<<" provided, but "<<dataChunks.size()<<" expected"<<std::endl;
+      moves.push_back({it->get_source_index(), offset, size});
     }
-    else
+    offset += size;
+  }
+  isInPlace = isInPlace && (offset == pSource->get_size());
+
+  if (isInPlace)
+  {
+    // the mapping may see the new bytes, the chunks are reloaded
+    CInPlaceWriter writer(inName, inMode);
+    retVal = writer.write(moves);
+    if (SStats *pStats = get_stats())
     {
-      // Reorder data
-      std::size_t i = 0;
-      for (auto it = firstIt; it != lastIt; ++it)
-      {
-        *it = dataChunks.at(inNewOrder.at(i++));
-      }
+      pStats->m_nbBytesWritten += writer.get_nb_bytes_written();
     }
+    m_chunks.clear();
+    m_index.clear();
+    m_sources.clear();
+    m_arena.clear();
+    SStats *pStats = m_pStats;
+    m_pStats = nullptr;
+    retVal &= load_from_PNG(inName);
+    m_pStats = pStats;
   }
   else
   {
-    std::cerr<<"No data !"<<std::endl;
+    std::cerr<<"Cannot rewrite '"<<inName<<"' in place: chunks are modified, dropped or not from this file"<<std::endl;
   }
-} // reorder_data_chunks
+  return retVal;
+} // save_in_place
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void CPNG::fix_end_chunk()
+void CPNG::build_output_plan(COutputPlan& outPlan, CThreadPool& ioPool)
 {
-  constexpr auto CHUNK="IEND";
-  // remove all existing chunks
-  std::vector<chunkIterator> ItToErase;
-  for (auto it = m_chunks.begin(); it != m_chunks.end(); ++it)
+  // invalid chunks are not saved
+  verify_chunks(ioPool);
+  outPlan.add_bytes(PNG_MAGIC_VALUE, SIZE_OF_PNG_MAGIC_VALUE);
+
+  uint8_t header[8];
+  uint8_t crc[4];
+  for (auto& chunk:m_chunks)
   {
-    if (it->get_type() == CHUNK)
+    if (chunk.is_valid())
     {
-      ItToErase.push_back(it);
+      if (chunk.is_source_identical())
+      {
+        outPlan.add_source_range(*chunk.get_source(), chunk.get_source_index(), chunk.get_size() + CChunk::get_header_size());
+      }
+      else
+      {
+        if (chunk.is_view())
+        {
+          outPlan.add_source_range(*chunk.get_source(), chunk.get_source_index(), chunk.get_size() + sizeof(header));
+        }
+        else
+        {
+          chunk.serialize_header(header);
+          outPlan.add_bytes(header, sizeof(header));
+          outPlan.add_memory(chunk.get_data(), chunk.get_size());
+        }
+        chunk.serialize_CRC32(crc);
+        outPlan.add_bytes(crc, sizeof(crc));
+      }
     }
   }
-
-  // erase all
-  for (auto it:ItToErase)
-  {
-    m_chunks.erase(it);
-  }
-
-  // add the end chunk
-  m_chunks.emplace_back(CHUNK, 0);
-  m_chunks.back().update_CRC32();
-} // fix_end_chunk
+} // build_output_plan
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void CPNG::fix_palette_chunk(const int32_t inIdChunkToKeep)
+std::size_t CPNG::verify_chunks(CThreadPool& ioPool)
 {
-  constexpr auto CHUNK="PLTE";
-  // remove all existing chunks
-  std::vector<chunkIterator> ItToErase;
-  chunkIterator itChunkToKeep = m_chunks.end();
+  CScopedPhase phase(get_stats(), SStats::EPhase::VERIFY);
+
+  // small chunks are grouped, huge ones split, in units of about VERIFY_UNIT_SIZE
+  struct SUnit
+  {
+    std::size_t m_position;   // first chunk
+    std::size_t m_nbChunks;   // 0 for a part of a chunk
+    std::size_t m_offset;     // part offset in the chunk data
+    std::size_t m_size;
+    uint32_t    m_crc32;      // CRC of the part
+  };
+  std::vector<SUnit> units;
+  std::size_t totalSize = 0;
 
-  std::size_t chunkId = 0;
-  for (auto it = m_chunks.begin(); it != m_chunks.end(); ++it)
+  for (std::size_t position = 0; position < m_chunks.size(); position++)
   {
-    if (it->get_type() == CHUNK)
+    const CChunk& chunk = m_chunks[position];
+    if (!chunk.is_CRC32_computed())
     {
-      if (inIdChunkToKeep >= 0 && chunkId == (std::size_t)inIdChunkToKeep)
+      const std::size_t size = chunk.get_size();
+      if (size > VERIFY_UNIT_SIZE)
+      {
+        for (std::size_t offset = 0; offset < size; offset += VERIFY_UNIT_SIZE)
+        {
+          units.push_back({position, 0, offset, std::min(VERIFY_UNIT_SIZE, size - offset), 0});
+        }
+      }
+      else if (!units.empty() && units.back().m_nbChunks > 0 && units.back().m_size + size <= VERIFY_UNIT_SIZE &&
+               units.back().m_position + units.back().m_nbChunks == position)
       {
-        itChunkToKeep = it;
+        units.back().m_nbChunks++;
+        units.back().m_size += size;
       }
       else
       {
-        ItToErase.push_back(it);
+        units.push_back({position, 1, 0, size, 0});
       }
-      chunkId++;
+      totalSize += size + 4;
     }
   }
+  if (SStats *pStats = get_stats())
+  {
+    pStats->m_nbCRCBytes += totalSize;
+  }
 
-  // manage case of last one
-  if (inIdChunkToKeep < 0 && !ItToErase.empty())
+  auto runUnit = [this, &units](std::size_t inUnit)
   {
-    itChunkToKeep = ItToErase.back();
-    ItToErase.resize(ItToErase.size()-1);
-  }  
+    SUnit& unit = units[inUnit];
+    if (unit.m_nbChunks > 0)
+    {
+      for (std::size_t i = 0; i < unit.m_nbChunks; i++)
+      {
+        m_chunks[unit.m_position + i].compute_CRC32();
+      }
+    }
+    else
+    {
+      unit.m_crc32 = CCRC32::compute(m_chunks[unit.m_position].get_data() + unit.m_offset, unit.m_size);
+    }
+  };
 
-  // clean
-  for (auto it:ItToErase)
+  if (totalSize > VERIFY_UNIT_SIZE && ioPool.get_nb_threads() > 1)
+  {
+    ioPool.parallel_for(units.size(), runUnit);
+  }
+  else
   {
-    m_chunks.erase(it);
+    for (std::size_t i = 0; i < units.size(); i++)
+    {
+      runUnit(i);
+    }
   }
 
-  // move before data
-  if (itChunkToKeep != m_chunks.end())
+  // stitch the parts: crc(type + part0 + part1...)
+  for (auto it = units.begin(); it != units.end(); )
   {
-    chunkIterator firstIt;
-    chunkIterator lastIt;
-    if (get_data_range(firstIt, lastIt))
+    if (it->m_nbChunks == 0)
+    {
+      const CChunk& chunk = m_chunks[it->m_position];
+      uint8_t type[4];
+      chunk.get_fourcc().to_bytes(type);
+      uint32_t crc = CCRC32::compute(type, sizeof(type));
+      const std::size_t position = it->m_position;
+      for (; it != units.end() && it->m_nbChunks == 0 && it->m_position == position; ++it)
+      {
+        crc = CCRC32::combine(crc, it->m_crc32, it->m_size);
+      }
+      chunk.set_computed_CRC32(crc);
+    }
+    else
     {
-      m_chunks.insert(firstIt, *itChunkToKeep);
-      m_chunks.erase(itChunkToKeep);
+      ++it;
     }
   }
-} // fix_palette_chunk
+
+  return std::count_if(m_chunks.begin(), m_chunks.end(), [](const CChunk& inChunk){ return inChunk.is_valid(); });
+} // verify_chunks
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
-void CPNG::fix_all()
-{
-  fix_palette_chunk();
-  fix_end_chunk();
-} // fix_all
-
-////////////////////////////////////////////////////////////////////////////
-void CPNG::clean_chunks(const std::vector<std::string>& inChunksToKeep)
+void CPNG::dump_chunks(std::ostream& ioStream, bool inOneLine)
 {
-  std::vector<chunkIterator> ItToErase;
-  for (auto it = m_chunks.begin(); it != m_chunks.end(); ++it)
+  verify_chunks();
+  std::size_t id = 0;
+  for (auto& chunk:m_chunks)
   {
-    auto itFound = std::find(inChunksToKeep.begin(), inChunksToKeep.end(), it->get_type());
-    if (itFound == inChunksToKeep.end())
+    if (chunk.is_valid())
     {
-      ItToErase.push_back(it);
+      ioStream << std::setw(3) << id++ << " # ";
+      chunk.dump(ioStream, inOneLine);
     }
   }
+} // dump_chunks
 
-  // erase all
-  for (auto it:ItToErase)
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void CPNG::dump_chunk_table(std::ostream& ioStream) const
+{
+  for (std::size_t i = 0; i < m_chunks.size(); i++)
   {
-    m_chunks.erase(it);
+    ioStream<<std::setw(3)<<i<<" # "<<m_chunks[i].get_type()<<" offset="<<get_chunk_offset(i)<<" size="<<m_chunks[i].get_size()<<std::endl;
   }
-} // clean_chunks
+} // dump_chunk_table
 
-////////////////////////////////////////////////////////////////////////////
-void CPNG::dump_header(std::ostream& ioStream)
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::size_t CPNG::load_chunks_from_buffer(const std::vector<uint8_t>& inBufData, const std::size_t inIndex)
 {
-  chunkContainer chunkToSearch;
-  chunkToSearch.emplace_back("IHDR", 0);
-  
-  auto it = std::find_first_of(m_chunks.begin(), m_chunks.end(), chunkToSearch.begin(), chunkToSearch.end(),
-                         [](const CChunk& inC1, const CChunk& inC2){ return inC1.get_type() == inC2.get_type(); } );
-  if (it != m_chunks.end())
-  {
-    it->dump_as_header(ioStream);
-  }
-  else
-  {
-    std::cerr<<"No header found"<<std::endl;
-  }
+  return load_chunks_from_buffer(CByteBuffer::create(std::vector<uint8_t>(inBufData)), inIndex);
+} // load_chunks_from_buffer
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::size_t CPNG::load_chunks_from_buffer(const sharedByteBuffer& inpBufData, const std::size_t inIndex)
+{
+  std::size_t nbChunkRead = 0;
+  SStats *pStats = get_stats();
+  CScopedPhase phase(pStats, SStats::EPhase::SCAN);
+
+  // the chunks are views over it
+  m_sources.push_back(inpBufData);
+
+  const uint8_t *pBufData = inpBufData->get_data();
+  const std::size_t fileSize = inpBufData->get_size();
+  std::size_t index = inIndex;
+  if (!CChunk::is_chunk_at(pBufData, fileSize, index))
+  {
+    index = find_next_chunk(pBufData, fileSize, index);
+    if (pStats)
+    {
+      pStats->m_nbResyncScans++;
+    }
+  }
+
+  // trust the size fields, scan only when they lead nowhere
+  while ( index < fileSize )
+  {
+    const std::size_t dataSize = CChunk::get_data_size(pBufData + index);
+    if (dataSize > m_limits.m_maxChunkSize)
+    {
+      // a chunk reached by the size fields, not a resync guess: the file
+      // itself is over the cap
+      m_lastError = {SError::ECode::CHUNK_TOO_LARGE, index, CFourCC::from_bytes(pBufData + index + sizeof(uint32_t)), dataSize};
+      break;
+    }
+    m_chunks.emplace_back(*inpBufData, index);
+    m_index.on_push_back(m_chunks.back());
+    const CChunk& chunk = m_chunks.back();
+    const std::size_t nextIndex = index + chunk.get_size() + CChunk::get_header_size();
+    if (pStats)
+    {
+      pStats->m_nbChunksByType[chunk.get_fourcc()]++;
+    }
+    if (nextIndex == fileSize || CChunk::is_chunk_at(pBufData, fileSize, nextIndex))
+    {
+      index = nextIndex;
+    }
+    else
+    {
+      if (pStats)
+      {
+        pStats->m_nbResyncScans++;
+        pStats->m_nbCRCBytes += chunk.is_CRC32_computed()? 0:chunk.get_size() + 4;
+      }
+      // garbage after a sound chunk, or the size itself may be wrong: then
+      // resume right after its size and type
+      index = find_next_chunk(pBufData, fileSize, chunk.is_valid()? nextIndex:index + sizeof(uint32_t) + 4);
+    }
+    nbChunkRead++;
+  }
+  record_payload_memory();
+
+  return nbChunkRead;
+} // load_chunks_from_buffer
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::size_t CPNG::load_chunks_from_file(const std::string& inName, const std::size_t inIndex)
+{
+  std::size_t nbChunkRead = 0;
+  sharedByteBuffer pBufData;
+  {
+    CScopedPhase phase(get_stats(), SStats::EPhase::READ);
+    pBufData = CByteBuffer::load_from_file(inName, true, m_limits.m_maxFileSize);
+  }
+  m_lastError = SError();
+  if (!pBufData)
+  {
+    set_read_error(inName);
+  }
+  else if (!pBufData->is_owned() || charge_memory(pBufData->get_size()))
+  {
+    if (SStats *pStats = get_stats())
+    {
+      pStats->m_nbBytesRead += pBufData->get_size();
+      pStats->m_nbFiles++;
+    }
+    nbChunkRead = load_chunks_from_buffer(pBufData, inIndex);
+  }
+
+  return nbChunkRead;
+} // load_chunks_from_file
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::size_t CPNG::find_next_chunk(const std::vector<uint8_t>& inBufData, std::size_t inIndex)
+{
+  return find_next_chunk(inBufData.data(), inBufData.size(), inIndex);
+} // find_next_chunk
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::size_t CPNG::find_next_chunk(const uint8_t *inpBufData, const std::size_t inBufSize, std::size_t inIndex)
+{
+  static constexpr auto KNOWN_TYPES = []()
+  {
+    std::array<CFourCC, CChunkRules::RULES.size()> types;
+    for (std::size_t i = 0; i < types.size(); i++)
+    {
+      types[i] = CChunkRules::RULES[i].m_type;
+    }
+    return types;
+  }();
+
+  // single pass, the nearest known type wins
+  std::size_t chunkIndex = inBufSize;
+  for (std::size_t i = std::max<std::size_t>(inIndex, sizeof(uint32_t)); i + sizeof(uint32_t) <= inBufSize; i++)
+  {
+    const CFourCC type = CFourCC::from_bytes(inpBufData + i);
+    // a type string inside compressed data is rejected by its size field
+    if (std::find(KNOWN_TYPES.begin(), KNOWN_TYPES.end(), type) != KNOWN_TYPES.end() &&
+        CChunk::is_chunk_at(inpBufData, inBufSize, i - sizeof(uint32_t)) &&
+        CChunk::get_data_size(inpBufData + i - sizeof(uint32_t)) <= m_limits.m_maxChunkSize)
+    {
+      chunkIndex = i - sizeof(uint32_t);
+      break;
+    }
+  }
+
+  return chunkIndex;
+} // find_next_chunk
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CPNG::rechunk_data(const std::size_t inTargetSize, CThreadPool& ioPool)
+{
+  CScopedPhase phase(get_stats(), SStats::EPhase::RECHUNK);
+  bool retVal = false;
+  std::size_t firstPosition = 0;
+  std::size_t lastPosition = 0;
+  if (inTargetSize == 0 || inTargetSize > MAX_CHUNK_SIZE)
+  {
+    std::cerr<<"Wrong data chunk size: "<<inTargetSize<<std::endl;
+  }
+  else if (!m_index.get_data_range(firstPosition, lastPosition))
+  {
+    std::cerr<<"No data !"<<std::endl;
+  }
+  else if (find_chunks("IDAT").size() != lastPosition - firstPosition + 1)
+  {
+    std::cerr<<"Data chunks are not consecutive"<<std::endl;
+  }
+  else
+  {
+    verify_chunks(ioPool);
+    std::size_t totalSize = 0;
+    bool isSound = true;
+    for (std::size_t position = firstPosition; position <= lastPosition; position++)
+    {
+      isSound &= m_chunks[position].is_valid();
+      totalSize += m_chunks[position].get_size();
+    }
+
+    if (!isSound)
+    {
+      std::cerr<<"Corrupted data chunk, cannot rechunk"<<std::endl;
+    }
+    else if (!charge_memory(totalSize))
+    {
+      std::cerr<<"Cannot rechunk: "<<m_lastError.get_message()<<std::endl;
+    }
+    else
+    {
+      // crc(data) = crc(type + data) ^ shift(crc(type), size)
+      const uint32_t typeCRC = CCRC32::compute((const uint8_t*)"IDAT", 4);
+      const std::size_t nbNewChunks = std::max<std::size_t>((totalSize + inTargetSize - 1) / inTargetSize, 1);
+      std::vector<CChunk> newChunks;
+      newChunks.reserve(nbNewChunks);
+
+      std::size_t oldPosition = firstPosition;
+      std::size_t oldOffset = 0;
+      uint32_t oldPrefixCRC = 0;      // of the hashed pieces of the old chunk
+      std::size_t nbHashedBytes = 0;
+      for (std::size_t i = 0; i < nbNewChunks; i++)
+      {
+        const std::size_t size = std::min(inTargetSize, totalSize - i * inTargetSize);
+        CChunk chunk("IDAT", size, m_arena);
+        uint8_t *pData = chunk.get_mutable_data(m_arena);
+        uint32_t crc = typeCRC;
+        for (std::size_t filled = 0; filled < size; )
+        {
+          const CChunk& oldChunk = m_chunks[oldPosition];
+          const std::size_t oldSize = oldChunk.get_size();
+          const std::size_t pieceSize = std::min(size - filled, oldSize - oldOffset);
+          std::memcpy(pData + filled, oldChunk.get_data() + oldOffset, pieceSize);
+
+          uint32_t pieceCRC = 0;
+          if (oldOffset + pieceSize == oldSize)
+          {
+            // whole chunk or last piece: derived from the chunk CRC
+            const uint32_t oldDataCRC = oldChunk.compute_CRC32() ^ CCRC32::combine(typeCRC, 0, oldSize);
+            pieceCRC = oldDataCRC ^ (oldOffset == 0? 0:CCRC32::combine(oldPrefixCRC, 0, pieceSize));
+          }
+          else
+          {
+            pieceCRC = CCRC32::compute(oldChunk.get_data() + oldOffset, pieceSize);
+            oldPrefixCRC = (oldOffset == 0)? pieceCRC:CCRC32::combine(oldPrefixCRC, pieceCRC, pieceSize);
+            nbHashedBytes += pieceSize;
+          }
+          crc = CCRC32::combine(crc, pieceCRC, pieceSize);
+
+          filled += pieceSize;
+          oldOffset += pieceSize;
+          if (oldOffset == oldSize)
+          {
+            oldPosition++;
+            oldOffset = 0;
+          }
+        }
+        chunk.set_computed_CRC32(crc);
+        chunk.update_CRC32();
+        newChunks.push_back(chunk);
+      }
+
+      m_chunks.erase(m_chunks.begin() + firstPosition, m_chunks.begin() + lastPosition + 1);
+      m_chunks.insert(m_chunks.begin() + firstPosition, newChunks.begin(), newChunks.end());
+      m_index.on_change(m_chunks, firstPosition);
+      if (SStats *pStats = get_stats())
+      {
+        pStats->m_nbCRCBytes += nbHashedBytes;
+      }
+      record_payload_memory();
+      retVal = true;
+    }
+  }
+
+  return retVal;
+} // rechunk_data
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CPNG::recompress_data(const int inLevel, const std::size_t inBlockSize, CThreadPool& ioPool)
+{
+  CScopedPhase phase(get_stats(), SStats::EPhase::RECOMPRESS);
+  bool retVal = false;
+  chunkIterator firstIt;
+  chunkIterator lastIt;
+  if (inLevel < 0 || inLevel > 9 || inBlockSize == 0)
+  {
+    std::cerr<<"Wrong compression level or block size: "<<inLevel<<", "<<inBlockSize<<std::endl;
+  }
+  else if (!get_data_range(firstIt, lastIt))
+  {
+    std::cerr<<"No data !"<<std::endl;
+  }
+  else if (find_chunks("IDAT").size() != std::size_t(lastIt - firstIt) + 1)
+  {
+    std::cerr<<"Data chunks are not consecutive"<<std::endl;
+  }
+  else
+  {
+    verify_chunks(ioPool);
+    std::vector<std::span<const uint8_t>> parts;
+    std::size_t oldSize = 0;
+    std::size_t chunkSize = 1;
+    bool isSound = true;
+    for (auto it = firstIt; it <= lastIt; ++it)
+    {
+      isSound &= it->is_valid();
+      parts.emplace_back(it->get_data(), it->get_size());
+      oldSize += it->get_size();
+      chunkSize = std::max(chunkSize, it->get_size());
+    }
+
+    // the image data is charged while it lives
+    std::vector<uint8_t> imageData;
+    std::size_t nbChargedBytes = 0;
+    bool isOutOfBudget = false;
+    std::vector<uint8_t> stream;
+    if (!isSound)
+    {
+      std::cerr<<"Corrupted data chunk, cannot recompress"<<std::endl;
+    }
+    else if (!CZlib::inflate(parts, imageData, [this, &nbChargedBytes, &isOutOfBudget](const std::size_t inNbMoreBytes)
+                                               {
+                                                 isOutOfBudget = !charge_memory(inNbMoreBytes);
+                                                 nbChargedBytes += isOutOfBudget? 0:inNbMoreBytes;
+                                                 return !isOutOfBudget;
+                                               }))
+    {
+      std::cerr<<"Cannot inflate the data chunks: "<<(isOutOfBudget? m_lastError.get_message():"damaged stream")<<std::endl;
+    }
+    else if (!CZlib::deflate_parallel(imageData, inLevel, inBlockSize, stream, ioPool))
+    {
+      std::cerr<<"Cannot deflate the image data"<<std::endl;
+    }
+    else if (stream.size() >= oldSize)
+    {
+      // nothing to gain, the old run stays
+      retVal = true;
+    }
+    else if (!charge_memory(stream.size()))
+    {
+      std::cerr<<"Cannot recompress: "<<m_lastError.get_message()<<std::endl;
+    }
+    else
+    {
+      std::vector<CChunk> newChunks;
+      for (std::size_t offset = 0; offset < stream.size(); offset += chunkSize)
+      {
+        const std::size_t size = std::min(chunkSize, stream.size() - offset);
+        CChunk chunk("IDAT", size, m_arena);
+        std::memcpy(chunk.get_mutable_data(m_arena), stream.data() + offset, size);
+        chunk.update_CRC32();
+        newChunks.push_back(chunk);
+      }
+
+      const std::size_t firstPosition = firstIt - m_chunks.begin();
+      m_chunks.erase(firstIt, lastIt + 1);
+      m_chunks.insert(m_chunks.begin() + firstPosition, newChunks.begin(), newChunks.end());
+      m_index.on_change(m_chunks, firstPosition);
+      if (SStats *pStats = get_stats())
+      {
+        pStats->m_nbCRCBytes += stream.size();
+      }
+      retVal = true;
+    }
+    release_memory(nbChargedBytes);
+    record_payload_memory();
+  }
+
+  return retVal;
+} // recompress_data
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+CPNG::SDataCheck CPNG::check_data_stream()
+{
+  CScopedPhase phase(get_stats(), SStats::EPhase::INFLATE);
+  SDataCheck retVal;
+  SImageHeader header;
+  chunkIterator firstIt;
+  chunkIterator lastIt;
+  retVal.m_result = get_data_stream(header, firstIt, lastIt);
+  if (retVal.m_result == SDataCheck::EResult::SOUND)
+  {
+    CScanlineInflater inflater(header);
+    for (auto it = firstIt; it <= lastIt; ++it)
+    {
+      inflater.feed(std::span<const uint8_t>(it->get_data(), it->get_size()));
+    }
+    switch (inflater.finish())
+    {
+      case CScanlineInflater::EState::DONE:       retVal.m_result = SDataCheck::EResult::SOUND; break;
+      case CScanlineInflater::EState::BAD_FILTER: retVal.m_result = SDataCheck::EResult::BAD_FILTER; break;
+      case CScanlineInflater::EState::TOO_LONG:   retVal.m_result = SDataCheck::EResult::TOO_LONG; break;
+      case CScanlineInflater::EState::TOO_SHORT:  retVal.m_result = SDataCheck::EResult::TOO_SHORT; break;
+      default:                                    retVal.m_result = SDataCheck::EResult::BAD_STREAM; break;
+    }
+    retVal.m_nbBytes = inflater.get_nb_bytes();
+    retVal.m_expectedSize = inflater.get_expected_size();
+    retVal.m_nbTrailingBytes = inflater.get_nb_trailing_bytes();
+  }
+  return retVal;
+} // check_data_stream
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CPNG::find_data_order(std::vector<std::size_t>& outOrder, CThreadPool& ioPool)
+{
+  CScopedPhase phase(get_stats(), SStats::EPhase::INFLATE);
+  bool retVal = false;
+  SImageHeader header;
+  chunkIterator firstIt;
+  chunkIterator lastIt;
+  const SDataCheck::EResult result = get_data_stream(header, firstIt, lastIt);
+  if (result != SDataCheck::EResult::SOUND)
+  {
+    SDataCheck check;
+    check.m_result = result;
+    std::cerr<<"Cannot search the data order: "<<check.get_message()<<std::endl;
+  }
+  else
+  {
+    std::vector<std::span<const uint8_t>> parts;
+    for (auto it = firstIt; it <= lastIt; ++it)
+    {
+      parts.emplace_back(it->get_data(), it->get_size());
+    }
+    CDataOrderSolver solver(header, parts);
+    retVal = solver.solve(ioPool);
+    if (retVal)
+    {
+      outOrder = solver.get_order();
+    }
+    else
+    {
+      std::cerr<<"No data order found"<<(solver.is_given_up()? " (search given up)":"")<<" after "<<solver.get_nb_feeds()<<" chunk feeds"<<std::endl;
+    }
+  }
+  return retVal;
+} // find_data_order
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+CPNG::SDataCheck::EResult CPNG::get_data_stream(SImageHeader& outHeader, chunkIterator& outFirstIt, chunkIterator& outLastIt)
+{
+  SDataCheck::EResult retVal = SDataCheck::EResult::SOUND;
+  const auto& headerChunks = m_index.get_chunks("IHDR");
+  if (headerChunks.empty() ||
+      !outHeader.parse(m_chunks[headerChunks.front()].get_data(), m_chunks[headerChunks.front()].get_size()) ||
+      !outHeader.is_valid())
+  {
+    retVal = SDataCheck::EResult::NO_HEADER;
+  }
+  else if (!get_data_range(outFirstIt, outLastIt))
+  {
+    retVal = SDataCheck::EResult::NO_DATA;
+  }
+  else if (find_chunks("IDAT").size() != std::size_t(outLastIt - outFirstIt) + 1)
+  {
+    retVal = SDataCheck::EResult::NOT_CONSECUTIVE;
+  }
+  return retVal;
+} // get_data_stream
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CPNG::get_data_range(chunkIterator& outFirstIt, chunkIterator& outLastIt)
+{
+  std::size_t firstPosition = 0;
+  std::size_t lastPosition = 0;
+  const bool retVal = m_index.get_data_range(firstPosition, lastPosition);
+  outFirstIt = m_chunks.begin() + firstPosition;
+  outLastIt = m_chunks.begin() + lastPosition;
+  return retVal;
+}  // get_data_range
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CPNG::reorder_data_chunks(const std::vector<std::size_t>& inNewOrder)
+{
+  CScopedPhase phase(get_stats(), SStats::EPhase::REORDER);
+  bool retVal = false;
+  std::size_t firstPosition = 0;
+  std::size_t lastPosition = 0;
+  if (m_index.get_data_range(firstPosition, lastPosition))
+  {
+    const std::size_t nbDataChunks = lastPosition - firstPosition + 1;
+
+    if (inNewOrder.size() != nbDataChunks)
+    {
+      std::cerr<<"Wrong number of chunks: "<<inNewOrder.size()<<" provided, but "<<nbDataChunks<<" expected"<<std::endl;
+    }
+    else
+    {
+      // the order must be a permutation: in range, no duplicates
+      std::vector<bool> isUsed(nbDataChunks, false);
+      bool isPermutation = true;
+      for (std::size_t i = 0; isPermutation && i < nbDataChunks; i++)
+      {
+        isPermutation = (inNewOrder[i] < nbDataChunks) && !isUsed[inNewOrder[i]];
+        if (isPermutation)
+        {
+          isUsed[inNewOrder[i]] = true;
+        }
+        else
+        {
+          std::cerr<<"Wrong chunk id in new order: "<<inNewOrder[i]<<(inNewOrder[i] < nbDataChunks? " is duplicated":" is out of range")<<std::endl;
+        }
+      }
+
+      if (isPermutation)
+      {
+        // follow the cycles, only descriptors move
+        std::vector<bool>& isPlaced = isUsed;
+        isPlaced.assign(nbDataChunks, false);
+        CChunk* pDataChunks = m_chunks.data() + firstPosition;
+        for (std::size_t start = 0; start < nbDataChunks; start++)
+        {
+          if (!isPlaced[start])
+          {
+            const CChunk startChunk = pDataChunks[start];
+            std::size_t i = start;
+            while (inNewOrder[i] != start)
+            {
+              pDataChunks[i] = pDataChunks[inNewOrder[i]];
+              isPlaced[i] = true;
+              i = inNewOrder[i];
+            }
+            pDataChunks[i] = startChunk;
+            isPlaced[i] = true;
+          }
+        }
+        // the chunks between the data chunks move with them
+        m_index.on_change(m_chunks, firstPosition);
+        retVal = true;
+      }
+    }
+  }
+  else
+  {
+    std::cerr<<"No data !"<<std::endl;
+  }
+
+  return retVal;
+} // reorder_data_chunks
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void CPNG::fix_end_chunk()
+{
+  constexpr CFourCC CHUNK("IEND");
+  // remove all existing chunks
+  erase_chunks(m_index.get_chunks(CHUNK));
+
+  // add the end chunk
+  m_chunks.emplace_back(CHUNK, 0, m_arena);
+  m_chunks.back().update_CRC32();
+  m_index.on_push_back(m_chunks.back());
+} // fix_end_chunk
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void CPNG::fix_palette_chunk(const int32_t inIdChunkToKeep)
+{
+  constexpr CFourCC CHUNK("PLTE");
+  // remove all existing chunks
+  std::vector<std::size_t> positionsToErase = m_index.get_chunks(CHUNK);
+  bool hasChunkToKeep = false;
+  CChunk chunkToKeep;
+
+  if (inIdChunkToKeep < 0 && !positionsToErase.empty())
+  {
+    // manage case of last one
+    hasChunkToKeep = true;
+    chunkToKeep = m_chunks[positionsToErase.back()];
+  }
+  else if (inIdChunkToKeep >= 0 && (std::size_t)inIdChunkToKeep < positionsToErase.size())
+  {
+    hasChunkToKeep = true;
+    chunkToKeep = m_chunks[positionsToErase.at(inIdChunkToKeep)];
+  }
+
+  // clean, the kept one too: it is put back before data
+  erase_chunks(positionsToErase);
+
+  // move before data
+  std::size_t firstPosition = 0;
+  std::size_t lastPosition = 0;
+  if (hasChunkToKeep && m_index.get_data_range(firstPosition, lastPosition))
+  {
+    m_chunks.insert(m_chunks.begin() + firstPosition, chunkToKeep);
+    m_index.on_change(m_chunks, firstPosition);
+  }
+} // fix_palette_chunk
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::vector<CPNG::SChunkChange> CPNG::fix_all(CThreadPool& ioPool)
+{
+  return normalize_chunks(ioPool);
+} // fix_all
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::vector<CPNG::SChunkChange> CPNG::normalize_chunks(CThreadPool& ioPool)
+{
+  using ERegion = CChunkRules::ERegion;
+  constexpr std::size_t NB_REGIONS = std::size_t(ERegion::END) + 1;
+  constexpr CFourCC PALETTE("PLTE");
+  constexpr CFourCC END("IEND");
+
+  CScopedPhase phase(get_stats(), SStats::EPhase::FIX);
+  verify_chunks(ioPool);
+  const std::size_t nbChunks = m_chunks.size();
+  const bool hasPalette = !m_index.get_chunks(PALETTE).empty();
+
+  // bucket every chunk by the region it goes to, in file order
+  std::array<std::vector<std::size_t>, NB_REGIONS> buckets;
+  std::vector<ERegion> regions(nbChunks);
+  std::vector<std::size_t> newPositions(nbChunks, SIZE_MAX);
+  std::vector<bool> isDropped(nbChunks, false);
+  std::unordered_map<CFourCC, std::size_t> keptPositions;     // single chunks
+  ERegion currentRegion = ERegion::BEFORE_PALETTE;
+  for (std::size_t position = 0; position < nbChunks; position++)
+  {
+    const CChunk& chunk = m_chunks[position];
+    const CFourCC type = chunk.get_fourcc();
+    const CChunkRules::SChunkRule& rule = CChunkRules::get_rule(type);
+    ERegion region = std::clamp(currentRegion, rule.m_firstRegion, rule.m_lastRegion);
+    if (!hasPalette && region == ERegion::BEFORE_DATA)
+    {
+      region = ERegion::BEFORE_PALETTE;
+    }
+    regions[position] = region;
+
+    // regions passed in the file
+    if (region == ERegion::PALETTE || region == ERegion::DATA)
+    {
+      currentRegion = std::max(currentRegion, ERegion(std::size_t(region) + 1));
+    }
+
+    if (!rule.m_isMultipleAllowed && chunk.is_valid())
+    {
+      auto itKept = keptPositions.find(type);
+      if (itKept == keptPositions.end())
+      {
+        keptPositions[type] = position;
+      }
+      else if (type == PALETTE)
+      {
+        isDropped[itKept->second] = true;
+        itKept->second = position;
+      }
+      else
+      {
+        isDropped[position] = true;
+      }
+    }
+    buckets[std::size_t(region)].push_back(position);
+  }
+
+  // concatenate the buckets
+  chunkContainer chunks;
+  chunks.reserve(nbChunks + 1);
+  std::size_t firstChangedPosition = SIZE_MAX;
+  for (const auto& bucket:buckets)
+  {
+    for (auto position:bucket)
+    {
+      if (!isDropped[position])
+      {
+        if (position != chunks.size())
+        {
+          firstChangedPosition = std::min(firstChangedPosition, chunks.size());
+        }
+        newPositions[position] = chunks.size();
+        chunks.push_back(m_chunks[position]);
+      }
+    }
+  }
+
+  // report in file order: a chunk moved when it goes before a chunk which
+  // preceded it (the end chunk when a chunk followed it)
+  std::vector<SChunkChange> changes;
+  std::size_t lastRegion = 0;
+  std::size_t endPosition = SIZE_MAX;
+  bool isEndMoved = false;
+  for (std::size_t position = 0; position < nbChunks; position++)
+  {
+    const CFourCC type = m_chunks[position].get_fourcc();
+    const std::size_t region = std::size_t(regions[position]);
+    if (isDropped[position])
+    {
+      changes.push_back({SChunkChange::EAction::DROPPED, type, position, SIZE_MAX});
+    }
+    else if (regions[position] == ERegion::END)
+    {
+      endPosition = std::min(endPosition, position);
+    }
+    else
+    {
+      if (region < lastRegion)
+      {
+        changes.push_back({SChunkChange::EAction::MOVED, type, position, newPositions[position]});
+      }
+      lastRegion = std::max(lastRegion, region);
+      if (endPosition != SIZE_MAX && !isEndMoved)
+      {
+        changes.push_back({SChunkChange::EAction::MOVED, END, endPosition, newPositions[endPosition]});
+        isEndMoved = true;
+      }
+    }
+  }
+
+  if (keptPositions.find(END) == keptPositions.end())
+  {
+    firstChangedPosition = std::min(firstChangedPosition, chunks.size());
+    chunks.emplace_back(END, 0, m_arena);
+    chunks.back().update_CRC32();
+    changes.push_back({SChunkChange::EAction::ADDED, END, SIZE_MAX, chunks.size() - 1});
+  }
+  if (chunks.size() != nbChunks)
+  {
+    firstChangedPosition = std::min(firstChangedPosition, std::min(chunks.size(), nbChunks));
+  }
+
+  if (firstChangedPosition != SIZE_MAX)
+  {
+    m_chunks = std::move(chunks);
+    m_index.on_change(m_chunks, firstChangedPosition);
+  }
+  record_payload_memory();
+
+  return changes;
+} // normalize_chunks
+
+////////////////////////////////////////////////////////////////////////////
+void CPNG::clean_chunks(const std::vector<CFourCC>& inChunksToKeep)
+{
+  CScopedPhase phase(get_stats(), SStats::EPhase::FIX);
+
+  // only the groups of the other types are visited
+  std::vector<std::size_t> positionsToErase;
+  for (auto type:m_index.get_types())
+  {
+    if (std::find(inChunksToKeep.begin(), inChunksToKeep.end(), type) == inChunksToKeep.end())
+    {
+      const auto& positions = m_index.get_chunks(type);
+      positionsToErase.insert(positionsToErase.end(), positions.begin(), positions.end());
+    }
+  }
+  std::sort(positionsToErase.begin(), positionsToErase.end());
+  erase_chunks(positionsToErase);
+} // clean_chunks
+
+////////////////////////////////////////////////////////////////////////////
+void CPNG::clean_chunks(const std::vector<std::string>& inChunksToKeep)
+{
+  std::vector<CFourCC> chunksToKeep;
+  chunksToKeep.reserve(inChunksToKeep.size());
+  for (const auto& name:inChunksToKeep)
+  {
+    chunksToKeep.push_back(CFourCC::from_string(name));
+  }
+  clean_chunks(chunksToKeep);
+} // clean_chunks
+
+////////////////////////////////////////////////////////////////////////////
+void CPNG::clean_chunks(std::initializer_list<CFourCC> inChunksToKeep)
+{
+  clean_chunks(std::vector<CFourCC>(inChunksToKeep));
+} // clean_chunks
+
+////////////////////////////////////////////////////////////////////////////
+void CPNG::dump_header(std::ostream& ioStream)
+{
+  const auto& headerChunks = m_index.get_chunks("IHDR");
+  if (!headerChunks.empty())
+  {
+    m_chunks[headerChunks.front()].dump_as_header(ioStream);
+  }
+  else
+  {
+    std::cerr<<"No header found"<<std::endl;
+  }
 } // dump_header
 
+////////////////////////////////////////////////////////////////////////////
+std::size_t CPNG::get_nb_chunks() const
+{
+  return m_chunks.size();
+} // get_nb_chunks
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CPNG::get_chunk_offset(const std::size_t inPosition) const
+{
+  return m_index.get_offset(inPosition, m_chunks);
+} // get_chunk_offset
+
+////////////////////////////////////////////////////////////////////////////
+const std::vector<std::size_t>& CPNG::find_chunks(const CFourCC inType) const
+{
+  return m_index.get_chunks(inType);
+} // find_chunks
+
+////////////////////////////////////////////////////////////////////////////
+void CPNG::erase_chunks(const std::vector<std::size_t>& inSortedPositions)
+{
+  if (!inSortedPositions.empty())
+  {
+    // one compaction pass over the descriptors
+    const std::size_t firstPosition = inSortedPositions.front();
+    std::size_t writePosition = firstPosition;
+    auto itToErase = inSortedPositions.begin();
+    for (std::size_t readPosition = firstPosition; readPosition < m_chunks.size(); readPosition++)
+    {
+      if (itToErase != inSortedPositions.end() && *itToErase == readPosition)
+      {
+        ++itToErase;
+      }
+      else
+      {
+        m_chunks[writePosition++] = m_chunks[readPosition];
+      }
+    }
+    m_chunks.resize(writePosition);
+    m_index.on_change(m_chunks, firstPosition);
+  }
+} // erase_chunks
+
+////////////////////////////////////////////////////////////////////////////
+CArena& CPNG::get_arena()
+{
+  return m_arena;
+} // get_arena
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void CPNG::set_stats(SStats* inpStats)
+{
+  m_pStats = inpStats;
+} // set_stats
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void CPNG::set_read_error(const std::string& inName)
+{
+  struct stat fileStat;
+  if (stat(inName.c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode) && std::size_t(fileStat.st_size) > m_limits.m_maxFileSize)
+  {
+    m_lastError = {SError::ECode::FILE_TOO_LARGE, 0, CFourCC(), std::size_t(fileStat.st_size)};
+  }
+  else
+  {
+    m_lastError = {SError::ECode::CANNOT_READ, 0, CFourCC(), 0};
+  }
+} // set_read_error
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+bool CPNG::charge_memory(const std::size_t inSizeInByte)
+{
+  bool retVal = false;
+  if (m_limits.m_pProcessBudget != nullptr && !m_limits.m_pProcessBudget->try_acquire(inSizeInByte))
+  {
+    m_lastError = {SError::ECode::OUT_OF_BUDGET, 0, CFourCC(), inSizeInByte};
+  }
+  else
+  {
+    m_nbChargedBytes += inSizeInByte;
+    retVal = true;
+  }
+  return retVal;
+} // charge_memory
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void CPNG::release_memory(const std::size_t inSizeInByte)
+{
+  if (m_limits.m_pProcessBudget != nullptr)
+  {
+    m_limits.m_pProcessBudget->release(inSizeInByte);
+  }
+  m_nbChargedBytes -= inSizeInByte;
+} // release_memory
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+std::string CPNG::get_temporary_output_name(const std::string& inName) const
+{
+  std::string retVal;
+  struct stat outputStat;
+  if (stat(inName.c_str(), &outputStat) == 0)
+  {
+    for (const auto& pSource:m_sources)
+    {
+      struct stat sourceStat;
+      const int fd = pSource->get_file_descriptor();
+      if (fd >= 0 && fstat(fd, &sourceStat) == 0 &&
+          sourceStat.st_dev == outputStat.st_dev && sourceStat.st_ino == outputStat.st_ino)
+      {
+        retVal = inName + ".reorder-tmp";
+      }
+    }
+  }
+  return retVal;
+} // get_temporary_output_name
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void CPNG::record_payload_memory()
+{
+  if (SStats *pStats = get_stats())
+  {
+    std::size_t payloadSize = m_arena.get_allocated_size();
+    for (const auto& pSource:m_sources)
+    {
+      payloadSize += pSource->is_owned()? pSource->get_size():0;
+    }
+    pStats->m_peakPayloadBytes = std::max(pStats->m_peakPayloadBytes, payloadSize);
+  }
+} // record_payload_memory
+
@@ -1,48 +1,253 @@
 #pragma once
 
 #include "CChunk.h"
+#include "CChunkIndex.h"
+#include "COutputPlan.h"
+#include "CInPlaceWriter.h"
+#include "CIOEngine.h"
+#include "CMemoryBudget.h"
+#include "CStats.h"
+#include "CThreadPool.h"
 
-#if 1
-  #include <list>
-  using chunkContainer = std::list<CChunk>;
-#else
-  using chunkContainer = std::vector<CChunk>;
-#endif
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <span>
+#include <string>
 
-using chunkIterator  = chunkContainer::iterator;
+struct SImageHeader;
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 class CPNG 
 {
   public:
+    ////////////////////////////////////////////////////////////////////////////
+    // STREAM writes every chunk through an ofstream, EXTENTS builds an output
+    // plan where unmodified chunks are ranges of the source file copied by
+    // the kernel.
+    enum class ESaveMode
+    {
+      STREAM,
+      EXTENTS
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // A change made by normalize_chunks().
+    struct SChunkChange
+    {
+      enum class EAction
+      {
+        MOVED,      // put before chunks which preceded it
+        DROPPED,    // illegal duplicate
+        ADDED       // missing end chunk
+      };
+
+      EAction     m_action;
+      CFourCC     m_type;
+      std::size_t m_fromPosition;   // SIZE_MAX for ADDED
+      std::size_t m_toPosition;     // SIZE_MAX for DROPPED
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Why the last load (or rechunk) stopped early.
+    struct SError
+    {
+      enum class ECode
+      {
+        NONE,
+        CANNOT_READ,
+        NOT_A_PNG,
+        FILE_TOO_LARGE,     // a file of m_size bytes
+        CHUNK_TOO_LARGE,    // m_type chunk of m_size bytes at m_offset
+        OUT_OF_BUDGET       // m_size more bytes not available in the process budget
+      };
+
+      ECode       m_code = ECode::NONE;
+      std::size_t m_offset = 0;
+      CFourCC     m_type;
+      std::size_t m_size = 0;
+
+      //////////////////////////////////////////////////////////////////////////
+      std::string get_message() const;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Result of check_data_stream().
+    struct SDataCheck
+    {
+      enum class EResult
+      {
+        SOUND,              // the stream gives exactly the filtered rows of the header
+        NO_HEADER,          // no IHDR, or a corrupted or unsupported one
+        NO_DATA,
+        NOT_CONSECUTIVE,    // other chunks between the data chunks
+        BAD_STREAM,         // zlib error, or no stream end after the last row
+        BAD_FILTER,         // unknown filter type at the start of a row
+        TOO_SHORT,          // fewer bytes than the rows
+        TOO_LONG            // more bytes than the rows
+      };
+
+      EResult     m_result = EResult::NO_HEADER;
+      std::size_t m_nbBytes = 0;            // inflated bytes checked
+      std::size_t m_expectedSize = 0;       // bytes of all the rows
+      std::size_t m_nbTrailingBytes = 0;    // data bytes after the stream end
+
+      //////////////////////////////////////////////////////////////////////////
+      std::string get_message() const;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Receives the saved png piece by piece, returns false to stop the save.
+    using sinkFunction = std::function<bool(std::span<const std::byte>)>;
+
     ////////////////////////////////////////////////////////////////////////////
     CPNG();
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Give the charged bytes back to the process budget.
+    ~CPNG();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // A copy would release the same charge twice and share the arena.
+    CPNG(const CPNG&) = delete;
+    CPNG& operator=(const CPNG&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Caps for the next loads: the file size and every size field are
+    // checked before the bytes are read or allocated, and the load stops at
+    // the first one over its cap. The owned bytes (files read rather than
+    // mapped, new chunk data) are charged to the process budget.
+    void set_memory_limits(const SMemoryLimits& inLimits);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Reset by each load.
+    const SError& get_last_error() const;
+
     ////////////////////////////////////////////////////////////////////////////
     bool load_from_PNG(const std::string& inName);
 
     ////////////////////////////////////////////////////////////////////////////
-    bool save_to_PNG(const std::string& inName);
+    // Walk the chunk headers with small preads, skipping the data by its
+    // size: the file is mapped without read-ahead, so the data and the CRC
+    // checks of a chunk are only read when used. A damaged header hands
+    // over to the regular parser, which reads the rest of the file.
+    bool load_lazily_from_PNG(const std::string& inName);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Magic check then chunks, for bytes already read (by a CIOEngine...).
+    bool load_from_buffer(const sharedByteBuffer& inpPngData);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Parse a png held by the caller without copying it: inData must stay
+    // valid as long as the chunks are used.
+    bool load_from_memory(std::span<const std::byte> inData);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Size of the png the save functions write, to allocate once.
+    std::size_t get_saved_size(CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Return the number of bytes written, 0 if outBuffer is too small.
+    std::size_t save_to_memory(std::span<std::byte> outBuffer, CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool save_to_sink(const sinkFunction& inSink, CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool save_to_PNG(const std::string& inName, const ESaveMode inMode = ESaveMode::EXTENTS, CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Queue the writes on ioEngine and return, inDone runs on an engine
+    // thread. The CPNG must not change nor be destroyed until then.
+    void save_to_PNG(const std::string& inName, CIOEngine& ioEngine, std::function<void(bool)>&& inDone,
+                     CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Rewrite inName, the loaded file, writing only the chunks that moved.
+    // Possible when every chunk is saved unmodified (a reorder keeps the
+    // file size), false otherwise. The chunks are reloaded from the file.
+    bool save_in_place(const std::string& inName, const CInPlaceWriter::EMode inMode = CInPlaceWriter::EMode::JOURNAL,
+                       CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Magic then every valid chunk.
+    void build_output_plan(COutputPlan& outPlan, CThreadPool& ioPool = CThreadPool::get_default());
 
     ////////////////////////////////////////////////////////////////////////////
     std::size_t load_chunks_from_file(const std::string& inName, const std::size_t inIndex = 0);
 
     ////////////////////////////////////////////////////////////////////////////
+    // inBufData is copied once, use the shared buffer version to avoid it.
     std::size_t load_chunks_from_buffer(const std::vector<uint8_t>& inBufData, const std::size_t inIndex = 0);
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Loaded chunks are views over inpBufData.
+    std::size_t load_chunks_from_buffer(const sharedByteBuffer& inpBufData, const std::size_t inIndex = 0);
+
     ////////////////////////////////////////////////////////////////////////////
     void dump_chunks(std::ostream& ioStream, bool inOneLine = true);
 
     ////////////////////////////////////////////////////////////////////////////
-    void reorder_data_chunks(const std::vector<std::size_t>& inNewOrder);
+    // Type, offset and size of every chunk, from the headers only: nothing
+    // is checked.
+    void dump_chunk_table(std::ostream& ioStream) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Compute the CRC of every chunk not checked yet on ioPool, huge chunks
+    // being split in parts. The results are kept by the chunks for the next
+    // is_valid() calls. Return the number of valid chunks.
+    // The save, fix and rechunk functions check the chunks on the pool they
+    // are given: a batch passes its own.
+    std::size_t verify_chunks(CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool reorder_data_chunks(const std::vector<std::size_t>& inNewOrder);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Split and merge the data chunks into chunks of inTargetSize bytes (the
+    // last one may be shorter), the compressed stream is unchanged. The CRCs
+    // are combined from the existing ones, only the pieces of split chunks
+    // are hashed. False if the data chunks are not consecutive or corrupted.
+    bool rechunk_data(const std::size_t inTargetSize, CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Inflate the data chunks once and deflate the image data again at
+    // inLevel (0-9), in blocks of inBlockSize bytes on ioPool, into a fresh
+    // run of data chunks as large as the largest old one. The other chunks
+    // do not move. The old run is kept when the new stream is not smaller.
+    // False if the data chunks are not consecutive, corrupted or their
+    // stream is damaged.
+    bool recompress_data(const int inLevel, const std::size_t inBlockSize = 128 << 10,
+                         CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Inflate the data chunks in file order through a fixed window and check
+    // the filtered rows against the header, Adam7 passes included: a valid
+    // filter type at the start of each row and exactly the bytes of all the
+    // rows. Constant memory, the image is never held. The CRCs are not
+    // checked, nor the pixels.
+    SDataCheck check_data_stream();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Search the order of the data chunks which gives a sound stream
+    // (CDataOrderSolver) on ioPool, in the form of reorder_data_chunks.
+    // False if the stream cannot be checked or no order is found.
+    bool find_data_order(std::vector<std::size_t>& outOrder, CThreadPool& ioPool = CThreadPool::get_default());
 
     ////////////////////////////////////////////////////////////////////////////
     bool get_data_range(chunkIterator& outFirstIt, chunkIterator& outLastIt);
 
     ////////////////////////////////////////////////////////////////////////////
+    // Scan for the nearest known chunk type from inIndex whose size fits in
+    // the buffer and the chunk cap, return the index of its chunk (size
+    // field) or the buffer size. Only used to resynchronize the parser on
+    // corrupted data.
     std::size_t find_next_chunk(const std::vector<uint8_t>& inBufData, std::size_t inIndex);
 
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t find_next_chunk(const uint8_t *inpBufData, const std::size_t inBufSize, std::size_t inIndex);
+
     ////////////////////////////////////////////////////////////////////////////
     void fix_end_chunk();
 
@@ -51,14 +256,105 @@ class CPNG
     void fix_palette_chunk(const int32_t inIdChunkToKeep = -1);
 
     ////////////////////////////////////////////////////////////////////////////
-    void fix_all();
+    // Put every chunk in a legal place (CChunkRules) in one stable bucketed
+    // pass: IHDR first, ancillary chunks kept in their region when allowed
+    // else moved to the nearest allowed one, IDATs consecutive, IEND last.
+    // Duplicates of single chunks are dropped, keeping the first valid one
+    // (the last for PLTE, as fix_palette_chunk), and a missing IEND is
+    // added. Invalid chunks are placed but not counted: they are not saved.
+    // Only the descriptors move.
+    std::vector<SChunkChange> normalize_chunks(CThreadPool& ioPool = CThreadPool::get_default());
 
     ////////////////////////////////////////////////////////////////////////////
-    void clean_chunks(const std::vector<std::string>& inChunksToKeep={"IHDR","IDAT","IEND"});
+    std::vector<SChunkChange> fix_all(CThreadPool& ioPool = CThreadPool::get_default());
+
+    ////////////////////////////////////////////////////////////////////////////
+    void clean_chunks(const std::vector<CFourCC>& inChunksToKeep={"IHDR","IDAT","IEND"});
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Types by name, a name which is not 4 chars long keeps nothing.
+    void clean_chunks(const std::vector<std::string>& inChunksToKeep);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // clean_chunks({"IHDR","IDAT"}) would be ambiguous between the two above.
+    void clean_chunks(std::initializer_list<CFourCC> inChunksToKeep);
 
     ////////////////////////////////////////////////////////////////////////////
     void dump_header(std::ostream& ioStream);
 
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t get_nb_chunks() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Offset in the saved file of the chunk at inPosition (all chunks
+    // counted), or the file size for inPosition == get_nb_chunks().
+    std::size_t get_chunk_offset(const std::size_t inPosition) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Positions of the chunks of the given type in file order.
+    const std::vector<std::size_t>& find_chunks(const CFourCC inType) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Where the data of new and mutated chunks is allocated.
+    CArena& get_arena();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The next operations add their counters to ioStats, nullptr to stop.
+    // Ignored when built without WITH_STATS.
+    void set_stats(SStats* inpStats);
+
   private:
-    chunkContainer m_chunks;
+    ////////////////////////////////////////////////////////////////////////////
+    // Inline so that the stats code vanishes without WITH_STATS.
+    SStats* get_stats() const
+    {
+#ifdef WITH_STATS
+      return m_pStats;
+#else
+      return nullptr;
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The header and the data chunks for a stream check, SOUND if they are
+    // usable, else why not.
+    SDataCheck::EResult get_data_stream(SImageHeader& outHeader, chunkIterator& outFirstIt, chunkIterator& outLastIt);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Record the failure of a file read, from its size.
+    void set_read_error(const std::string& inName);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Take inSizeInByte more owned bytes from the process budget, false and
+    // the error set when not available.
+    bool charge_memory(const std::size_t inSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Give back bytes charged for a temporary buffer.
+    void release_memory(const std::size_t inSizeInByte);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // A temporary name next to inName when inName is a mapped source: the
+    // chunks still view its bytes, opening it with O_TRUNC would cut them.
+    // The save goes to the temporary file renamed over inName. Empty when
+    // inName can be written directly.
+    std::string get_temporary_output_name(const std::string& inName) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Owned sources and arena, mapped or borrowed sources are not counted.
+    void record_payload_memory();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // inSortedPositions are sorted, and may be a view of the index.
+    void erase_chunks(const std::vector<std::size_t>& inSortedPositions);
+
+    // chunk data lives in the sources or the arena
+    std::vector<sharedByteBuffer> m_sources;
+    CArena                        m_arena;
+    chunkContainer                m_chunks;
+    CChunkIndex                   m_index;
+    SStats                       *m_pStats = nullptr;
+    SMemoryLimits                 m_limits;
+    SError                        m_lastError;
+    std::size_t                   m_nbChargedBytes = 0;
 }; // class CPNG 
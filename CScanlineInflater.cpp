@@ -0,0 +1,172 @@
+#include "CScanlineInflater.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+
+// Output window, inflated bytes are checked then dropped.
+constexpr std::size_t WINDOW_SIZE = 32768;
+
+// Highest PNG filter type (Paeth).
+constexpr uint8_t MAX_FILTER_TYPE = 4;
+
+////////////////////////////////////////////////////////////////////////////
+CScanlineInflater::CScanlineInflater(const SImageHeader& inHeader)
+: m_pStream(std::make_unique<z_stream_s>())
+, m_window(WINDOW_SIZE)
+, m_nbPasses(inHeader.get_passes(m_passes))
+, m_pass(0)
+, m_nbRowsLeft(m_passes[0].m_nbRows)
+, m_positionInRow(0)
+, m_nbBytes(0)
+, m_expectedSize(inHeader.get_filtered_size())
+, m_nbTrailingBytes(0)
+, m_state(EState::RUNNING)
+{
+  if (inflateInit(m_pStream.get()) != Z_OK)
+  {
+    m_state = EState::BAD_STREAM;
+  }
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CScanlineInflater::CScanlineInflater(const CScanlineInflater& inOther)
+: m_pStream(std::make_unique<z_stream_s>())
+, m_window(WINDOW_SIZE)
+, m_passes(inOther.m_passes)
+, m_nbPasses(inOther.m_nbPasses)
+, m_pass(inOther.m_pass)
+, m_nbRowsLeft(inOther.m_nbRowsLeft)
+, m_positionInRow(inOther.m_positionInRow)
+, m_nbBytes(inOther.m_nbBytes)
+, m_expectedSize(inOther.m_expectedSize)
+, m_nbTrailingBytes(inOther.m_nbTrailingBytes)
+, m_state(inOther.m_state)
+{
+  // a failed copy has no zlib state to end
+  if (inflateCopy(m_pStream.get(), inOther.m_pStream.get()) != Z_OK)
+  {
+    m_pStream.reset();
+    m_state = EState::BAD_STREAM;
+  }
+} // copy constructor
+
+////////////////////////////////////////////////////////////////////////////
+CScanlineInflater::~CScanlineInflater()
+{
+  if (m_pStream)
+  {
+    inflateEnd(m_pStream.get());
+  }
+} // destructor
+
+////////////////////////////////////////////////////////////////////////////
+CScanlineInflater::EState CScanlineInflater::feed(std::span<const uint8_t> inData)
+{
+  if (m_state == EState::RUNNING)
+  {
+    m_pStream->next_in = const_cast<Bytef*>(inData.data());
+    m_pStream->avail_in = inData.size();
+    bool isWindowFull = false;
+    // a full window may hide pending bytes even with all the input read
+    do
+    {
+      m_pStream->next_out = m_window.data();
+      m_pStream->avail_out = m_window.size();
+      const int result = ::inflate(m_pStream.get(), Z_NO_FLUSH);
+      isWindowFull = (m_pStream->avail_out == 0);
+      check_scanlines(m_window.size() - m_pStream->avail_out);
+      // a fault in the rows comes first
+      if (m_state == EState::RUNNING && result == Z_STREAM_END)
+      {
+        m_state = is_layout_complete()? EState::DONE:EState::TOO_SHORT;
+        m_nbTrailingBytes += m_pStream->avail_in;
+      }
+      else if (m_state == EState::RUNNING && result != Z_OK && result != Z_BUF_ERROR)
+      {
+        m_state = EState::BAD_STREAM;
+      }
+    }
+    while (m_state == EState::RUNNING && (m_pStream->avail_in > 0 || isWindowFull));
+  }
+  else if (m_state == EState::DONE)
+  {
+    m_nbTrailingBytes += inData.size();
+  }
+  return m_state;
+} // feed
+
+////////////////////////////////////////////////////////////////////////////
+CScanlineInflater::EState CScanlineInflater::finish()
+{
+  if (m_state == EState::RUNNING)
+  {
+    m_state = is_layout_complete()? EState::BAD_STREAM:EState::TOO_SHORT;
+  }
+  return m_state;
+} // finish
+
+////////////////////////////////////////////////////////////////////////////
+void CScanlineInflater::check_scanlines(const std::size_t inSize)
+{
+  std::size_t position = 0;
+  while (m_state == EState::RUNNING && position < inSize)
+  {
+    if (is_layout_complete())
+    {
+      m_state = EState::TOO_LONG;
+    }
+    else if (m_positionInRow == 0 && m_window[position] > MAX_FILTER_TYPE)
+    {
+      m_state = EState::BAD_FILTER;
+    }
+    else
+    {
+      // the pixels are skipped, only the row boundaries matter
+      const std::size_t rowSize = m_passes[m_pass].m_rowSize;
+      const std::size_t step = std::min(rowSize - m_positionInRow, inSize - position);
+      position += step;
+      m_nbBytes += step;
+      m_positionInRow += step;
+      if (m_positionInRow == rowSize)
+      {
+        m_positionInRow = 0;
+        m_nbRowsLeft--;
+        if (m_nbRowsLeft == 0 && ++m_pass < m_nbPasses)
+        {
+          m_nbRowsLeft = m_passes[m_pass].m_nbRows;
+        }
+      }
+    }
+  }
+} // check_scanlines
+
+////////////////////////////////////////////////////////////////////////////
+bool CScanlineInflater::is_layout_complete() const
+{
+  return m_pass >= m_nbPasses;
+} // is_layout_complete
+
+////////////////////////////////////////////////////////////////////////////
+CScanlineInflater::EState CScanlineInflater::get_state() const
+{
+  return m_state;
+} // get_state
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CScanlineInflater::get_nb_bytes() const
+{
+  return m_nbBytes;
+} // get_nb_bytes
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CScanlineInflater::get_expected_size() const
+{
+  return m_expectedSize;
+} // get_expected_size
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CScanlineInflater::get_nb_trailing_bytes() const
+{
+  return m_nbTrailingBytes;
+} // get_nb_trailing_bytes
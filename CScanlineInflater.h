@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CImageHeader.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+struct z_stream_s;
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Inflate the zlib stream of the data chunks piece by piece through a fixed
+// output window and check the filtered scanlines it gives against the layout
+// of the header: a filter type (0-4) at the start of every row, and exactly
+// the bytes of all the rows. The image is never held, the memory is the
+// window plus the zlib state whatever the image size.
+class CScanlineInflater
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    enum class EState
+    {
+      RUNNING,      // every byte so far fits, more input expected
+      DONE,         // the stream ended on the last byte of the last row
+      BAD_STREAM,   // zlib error, or the input ended after the last row without the stream end
+      BAD_FILTER,   // unknown filter type at the start of a row
+      TOO_LONG,     // more bytes than the rows
+      TOO_SHORT     // the stream (or the input) ended before the last row
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // For a valid header (SImageHeader::is_valid).
+    explicit CScanlineInflater(const SImageHeader& inHeader);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Same state, zlib history included (inflateCopy): both go on from here
+    // with different inputs.
+    CScanlineInflater(const CScanlineInflater& inOther);
+
+    CScanlineInflater& operator=(const CScanlineInflater&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    ~CScanlineInflater();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Inflate the next piece of the stream while RUNNING. After the stream
+    // end, the bytes left are counted as trailing bytes.
+    EState feed(std::span<const uint8_t> inData);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // No more input: a stream still RUNNING is cut short.
+    EState finish();
+
+    ////////////////////////////////////////////////////////////////////////////
+    EState get_state() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Inflated bytes checked so far.
+    std::size_t get_nb_bytes() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Bytes of all the rows, SIZE_MAX if it does not fit.
+    std::size_t get_expected_size() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Input bytes fed after the stream end.
+    std::size_t get_nb_trailing_bytes() const;
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Walk the rows over inSize new bytes of the window.
+    void check_scanlines(const std::size_t inSize);
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool is_layout_complete() const;
+
+    std::unique_ptr<z_stream_s> m_pStream;
+    std::vector<uint8_t> m_window;
+    std::array<SImageHeader::SPass, SImageHeader::NB_ADAM7_PASSES> m_passes;
+    std::size_t m_nbPasses;
+    std::size_t m_pass;             // current pass
+    std::size_t m_nbRowsLeft;       // in the current pass
+    std::size_t m_positionInRow;    // 0 on a filter-type byte
+    std::size_t m_nbBytes;
+    std::size_t m_expectedSize;
+    std::size_t m_nbTrailingBytes;
+    EState m_state;
+}; // class CScanlineInflater
@@ -0,0 +1,109 @@
+#include "CStats.h"
+
+#include <algorithm>
+#include <iomanip>
+
+////////////////////////////////////////////////////////////////////////////
+void SStats::add_phase(const EPhase inPhase, const double inWallSeconds, const double inCPUSeconds)
+{
+  SPhase& phase = m_phases[std::size_t(inPhase)];
+  phase.m_wallSeconds += inWallSeconds;
+  phase.m_cpuSeconds += inCPUSeconds;
+  phase.m_nbCalls++;
+} // add_phase
+
+////////////////////////////////////////////////////////////////////////////
+void SStats::merge(const SStats& inStats)
+{
+  for (std::size_t i = 0; i < m_phases.size(); i++)
+  {
+    m_phases[i].m_wallSeconds += inStats.m_phases[i].m_wallSeconds;
+    m_phases[i].m_cpuSeconds += inStats.m_phases[i].m_cpuSeconds;
+    m_phases[i].m_nbCalls += inStats.m_phases[i].m_nbCalls;
+  }
+  m_nbBytesRead += inStats.m_nbBytesRead;
+  m_nbBytesWritten += inStats.m_nbBytesWritten;
+  m_nbCRCBytes += inStats.m_nbCRCBytes;
+  m_nbResyncScans += inStats.m_nbResyncScans;
+  m_peakPayloadBytes = std::max(m_peakPayloadBytes, inStats.m_peakPayloadBytes);
+  m_nbFiles += inStats.m_nbFiles;
+  for (const auto& count:inStats.m_nbChunksByType)
+  {
+    m_nbChunksByType[count.first] += count.second;
+  }
+} // merge
+
+////////////////////////////////////////////////////////////////////////////
+void SStats::dump(std::ostream& ioStream) const
+{
+  ioStream<<"Stats:"<<std::endl;
+  ioStream<<"  phase      calls      wall(ms)       cpu(ms)"<<std::endl;
+  for (std::size_t i = 0; i < m_phases.size(); i++)
+  {
+    const SPhase& phase = m_phases[i];
+    ioStream<<"  "<<std::left<<std::setw(8)<<get_phase_name(EPhase(i))<<std::right
+            <<std::setw(8)<<phase.m_nbCalls
+            <<std::fixed<<std::setprecision(3)
+            <<std::setw(14)<<phase.m_wallSeconds*1e3
+            <<std::setw(14)<<phase.m_cpuSeconds*1e3<<std::endl;
+  }
+  ioStream<<"  files: "<<m_nbFiles<<std::endl;
+  ioStream<<"  bytes read: "<<m_nbBytesRead<<std::endl;
+  ioStream<<"  bytes written: "<<m_nbBytesWritten<<std::endl;
+  ioStream<<"  CRC bytes hashed: "<<m_nbCRCBytes<<std::endl;
+  ioStream<<"  resync scans: "<<m_nbResyncScans<<std::endl;
+  ioStream<<"  peak payload memory: "<<m_peakPayloadBytes<<" bytes"<<std::endl;
+  ioStream<<"  chunks:";
+  for (const auto& count:m_nbChunksByType)
+  {
+    ioStream<<" "<<count.first.to_string()<<"="<<count.second;
+  }
+  ioStream<<std::endl;
+} // dump
+
+////////////////////////////////////////////////////////////////////////////
+void SStats::dump_json(std::ostream& ioStream) const
+{
+  ioStream<<"{\"phases\": {";
+  for (std::size_t i = 0; i < m_phases.size(); i++)
+  {
+    const SPhase& phase = m_phases[i];
+    ioStream<<(i > 0? ", ":"")<<"\""<<get_phase_name(EPhase(i))<<"\": {\"calls\": "<<phase.m_nbCalls
+            <<std::fixed<<std::setprecision(6)
+            <<", \"wall_s\": "<<phase.m_wallSeconds<<", \"cpu_s\": "<<phase.m_cpuSeconds<<"}";
+  }
+  ioStream<<"}, \"files\": "<<m_nbFiles
+          <<", \"bytes_read\": "<<m_nbBytesRead
+          <<", \"bytes_written\": "<<m_nbBytesWritten
+          <<", \"crc_bytes\": "<<m_nbCRCBytes
+          <<", \"resync_scans\": "<<m_nbResyncScans
+          <<", \"peak_payload_bytes\": "<<m_peakPayloadBytes
+          <<", \"chunks\": {";
+  bool isFirst = true;
+  for (const auto& count:m_nbChunksByType)
+  {
+    // types are checked letters by the parser, nothing to escape
+    ioStream<<(isFirst? "":", ")<<"\""<<count.first.to_string()<<"\": "<<count.second;
+    isFirst = false;
+  }
+  ioStream<<"}}"<<std::endl;
+} // dump_json
+
+////////////////////////////////////////////////////////////////////////////
+const char* SStats::get_phase_name(const EPhase inPhase)
+{
+  switch (inPhase)
+  {
+    case EPhase::READ:       return "read";
+    case EPhase::SCAN:       return "scan";
+    case EPhase::VERIFY:     return "verify";
+    case EPhase::REORDER:    return "reorder";
+    case EPhase::RECHUNK:    return "rechunk";
+    case EPhase::RECOMPRESS: return "recompress";
+    case EPhase::INFLATE:    return "inflate";
+    case EPhase::FIX:        return "fix";
+    case EPhase::WRITE:      return "write";
+    default:              break;
+  }
+  return "unknown";
+} // get_phase_name
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "CFourCC.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <map>
+#include <ostream>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Counters of the reorder pipeline, filled by a CPNG given to set_stats().
+// Phases may nest (a save verifies the chunks first). CPU time is the one of
+// the thread running the phase: the files of a batch run side by side are
+// not counted by each other, but the work a phase hands to the pool only
+// shows in its wall time.
+struct SStats
+{
+  enum class EPhase
+  {
+    READ,       // open or map the file
+    SCAN,       // walk the chunks
+    VERIFY,     // CRC checks
+    REORDER,
+    RECHUNK,    // rechunk_data
+    RECOMPRESS, // recompress_data
+    INFLATE,    // check_data_stream, find_data_order
+    FIX,        // fix_all, clean_chunks
+    WRITE,
+    NB_PHASES
+  };
+
+  struct SPhase
+  {
+    double      m_wallSeconds = 0.;
+    double      m_cpuSeconds = 0.;
+    std::size_t m_nbCalls = 0;
+  };
+
+  std::array<SPhase, std::size_t(EPhase::NB_PHASES)> m_phases;
+  std::size_t                        m_nbBytesRead = 0;
+  std::size_t                        m_nbBytesWritten = 0;
+  std::size_t                        m_nbCRCBytes = 0;          // bytes hashed
+  std::size_t                        m_nbResyncScans = 0;       // find_next_chunk calls of the parser
+  std::size_t                        m_peakPayloadBytes = 0;    // owned sources + arena
+  std::size_t                        m_nbFiles = 0;
+  std::map<CFourCC, std::size_t>     m_nbChunksByType;          // as loaded
+
+  ////////////////////////////////////////////////////////////////////////////
+  void add_phase(const EPhase inPhase, const double inWallSeconds, const double inCPUSeconds);
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Sum the counters, the peak memory being the max.
+  void merge(const SStats& inStats);
+
+  ////////////////////////////////////////////////////////////////////////////
+  void dump(std::ostream& ioStream) const;
+
+  ////////////////////////////////////////////////////////////////////////////
+  void dump_json(std::ostream& ioStream) const;
+
+  ////////////////////////////////////////////////////////////////////////////
+  static const char* get_phase_name(const EPhase inPhase);
+}; // struct SStats
+
+#ifdef WITH_STATS
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Time its scope into a phase, nothing when inpStats is null.
+class CScopedPhase
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    CScopedPhase(SStats *inpStats, const SStats::EPhase inPhase)
+      : m_pStats(inpStats), m_phase(inPhase)
+    {
+      if (m_pStats)
+      {
+        m_wallStart = std::chrono::steady_clock::now();
+        m_cpuStart = get_thread_cpu_seconds();
+      }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    ~CScopedPhase()
+    {
+      if (m_pStats)
+      {
+        const std::chrono::duration<double> wall = std::chrono::steady_clock::now() - m_wallStart;
+        m_pStats->add_phase(m_phase, wall.count(), get_thread_cpu_seconds() - m_cpuStart);
+      }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    CScopedPhase(const CScopedPhase&) = delete;
+    CScopedPhase& operator=(const CScopedPhase&) = delete;
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    static double get_thread_cpu_seconds()
+    {
+      struct timespec time;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+      return time.tv_sec + time.tv_nsec * 1e-9;
+    }
+
+    SStats                                *m_pStats;
+    SStats::EPhase                         m_phase;
+    std::chrono::steady_clock::time_point  m_wallStart;
+    double                                 m_cpuStart = 0.;
+}; // class CScopedPhase
+#else
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+class CScopedPhase
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    CScopedPhase(SStats*, const SStats::EPhase) {}
+}; // class CScopedPhase
+#endif
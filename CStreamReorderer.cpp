@@ -0,0 +1,396 @@
+#include "CStreamReorderer.h"
+#include "CCRC32.h"
+#include "CFourCC.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+namespace
+{
+constexpr uint8_t PNG_MAGIC_VALUE[] = {0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a};
+constexpr uint32_t MAX_DATA_SIZE = 0x7fffffff;
+constexpr std::size_t BLOCK_SIZE = 64 << 10;
+
+////////////////////////////////////////////////////////////////////////////
+uint32_t get_big_endian(const uint8_t *inpData)
+{
+  return (uint32_t(inpData[0]) << 24) | (uint32_t(inpData[1]) << 16) | (uint32_t(inpData[2]) << 8) | inpData[3];
+} // get_big_endian
+
+////////////////////////////////////////////////////////////////////////////
+bool is_letter(const uint8_t inChar)
+{
+  return (inChar >= 'A' && inChar <= 'Z') || (inChar >= 'a' && inChar <= 'z');
+} // is_letter
+}
+
+////////////////////////////////////////////////////////////////////////////
+CStreamReorderer::CStreamReorderer(const std::vector<std::size_t>& inNewOrder, const std::size_t inMaxBufferedBytes)
+: m_newOrder(inNewOrder),
+  m_maxBufferedBytes(inMaxBufferedBytes),
+  m_memorySize(0),
+  m_pSpillFile(nullptr),
+  m_spillSize(0),
+  m_nextOutput(0),
+  m_block(BLOCK_SIZE),
+  m_nbBadCRCs(0),
+  m_pStats(nullptr)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CStreamReorderer::~CStreamReorderer()
+{
+  if (m_pSpillFile)
+  {
+    std::fclose(m_pSpillFile);
+  }
+} // destructor
+
+////////////////////////////////////////////////////////////////////////////
+bool CStreamReorderer::run(const int inInputFd, const int inOutputFd)
+{
+  // the order must be a permutation: in range, no duplicates
+  std::vector<bool> isUsed(m_newOrder.size(), false);
+  bool isOrderOk = true;
+  for (std::size_t i = 0; isOrderOk && i < m_newOrder.size(); i++)
+  {
+    isOrderOk = (m_newOrder[i] < m_newOrder.size()) && !isUsed[m_newOrder[i]];
+    if (isOrderOk)
+    {
+      isUsed[m_newOrder[i]] = true;
+    }
+    else
+    {
+      std::cerr<<"Wrong chunk id in new order: "<<m_newOrder[i]<<(m_newOrder[i] < m_newOrder.size()? " is duplicated":" is out of range")<<std::endl;
+    }
+  }
+
+  uint8_t magic[sizeof(PNG_MAGIC_VALUE)];
+  bool retVal = isOrderOk && read_exact(inInputFd, magic, sizeof(magic)) && std::memcmp(magic, PNG_MAGIC_VALUE, sizeof(magic)) == 0;
+  if (isOrderOk && !retVal)
+  {
+    std::cerr<<"Not a png stream"<<std::endl;
+  }
+  retVal = retVal && write_exact(inOutputFd, magic, sizeof(magic));
+  if (m_pStats)
+  {
+    m_pStats->m_nbFiles++;
+  }
+
+  std::size_t dataIndex = 0;
+  std::size_t nbInputBytes = sizeof(magic);
+  bool isEnd = false;
+  uint8_t header[8];
+  while (retVal && !isEnd)
+  {
+    if (!read_exact(inInputFd, header, sizeof(header), &isEnd))
+    {
+      retVal = isEnd;
+      if (!isEnd)
+      {
+        std::cerr<<"Truncated chunk header"<<std::endl;
+      }
+    }
+    else if (get_big_endian(header) > MAX_DATA_SIZE ||
+             !is_letter(header[4]) || !is_letter(header[5]) || !is_letter(header[6]) || !is_letter(header[7]))
+    {
+      std::cerr<<"Damaged chunk header, the stream stops there"<<std::endl;
+      retVal = false;
+    }
+    else if (get_big_endian(header) > m_limits.m_maxChunkSize ||
+             get_big_endian(header) + 12 > m_limits.m_maxFileSize - std::min(nbInputBytes, m_limits.m_maxFileSize))
+    {
+      std::cerr<<"Chunk '"<<CFourCC::from_bytes(header + 4).to_string()<<"' of "<<get_big_endian(header)
+               <<" bytes over the memory limits, the stream stops there"<<std::endl;
+      retVal = false;
+    }
+    else
+    {
+      nbInputBytes += get_big_endian(header) + 12;
+      if (m_pStats)
+      {
+        m_pStats->m_nbChunksByType[CFourCC::from_bytes(header + 4)]++;
+      }
+
+      if (CFourCC::from_bytes(header + 4) == CFourCC("IDAT"))
+      {
+        if (dataIndex < m_newOrder.size() && m_newOrder[m_nextOutput] != dataIndex)
+        {
+          // early, kept until its turn
+          retVal = copy_chunk(inInputFd, inOutputFd, header, dataIndex);
+        }
+        else
+        {
+          if (dataIndex >= m_newOrder.size() && !m_newOrder.empty())
+          {
+            // more data chunks than expected
+            isOrderOk = false;
+            retVal = write_all_buffered_chunks(inOutputFd);
+          }
+          retVal = retVal && copy_chunk(inInputFd, inOutputFd, header);
+          m_nextOutput += (dataIndex < m_newOrder.size())? 1:0;
+          retVal = retVal && write_ready_chunks(inOutputFd);
+        }
+        dataIndex++;
+      }
+      else
+      {
+        if (!m_bufferedChunks.empty())
+        {
+          // the data chunks ended before the order did
+          isOrderOk = false;
+          retVal = write_all_buffered_chunks(inOutputFd);
+        }
+        retVal = retVal && copy_chunk(inInputFd, inOutputFd, header);
+      }
+    }
+  }
+
+  if (!m_bufferedChunks.empty())
+  {
+    isOrderOk = false;
+    retVal = write_all_buffered_chunks(inOutputFd) && retVal;
+  }
+  if (retVal && !m_newOrder.empty() && dataIndex != m_newOrder.size())
+  {
+    isOrderOk = false;
+  }
+  if (retVal && !isOrderOk)
+  {
+    std::cerr<<"Wrong number of chunks: "<<m_newOrder.size()<<" provided, but "<<dataIndex<<" found"<<std::endl;
+  }
+  if (m_nbBadCRCs > 0)
+  {
+    std::cerr<<"Warning: "<<m_nbBadCRCs<<" chunk(s) with a wrong CRC passed through"<<std::endl;
+  }
+
+  return retVal && isOrderOk;
+} // run
+
+////////////////////////////////////////////////////////////////////////////
+void CStreamReorderer::set_stats(SStats* inpStats)
+{
+  m_pStats = inpStats;
+} // set_stats
+
+////////////////////////////////////////////////////////////////////////////
+void CStreamReorderer::set_memory_limits(const SMemoryLimits& inLimits)
+{
+  m_limits = inLimits;
+} // set_memory_limits
+
+////////////////////////////////////////////////////////////////////////////
+bool CStreamReorderer::copy_chunk(const int inInputFd, const int inOutputFd, const uint8_t *inpHeader, const std::size_t inDataIndex)
+{
+  const std::size_t dataSize = get_big_endian(inpHeader);
+  const bool isBuffered = (inDataIndex != SIZE_MAX);
+  SBufferedChunk chunk;
+  chunk.m_size = dataSize + 12;
+  chunk.m_isSpilled = (m_memorySize + chunk.m_size > m_maxBufferedBytes);
+  chunk.m_offset = chunk.m_isSpilled? m_spillSize:m_memorySize;
+  chunk.m_size = 0;
+
+  auto output = [&](const uint8_t *inpData, const std::size_t inSize)
+  {
+    return isBuffered? append_to_buffer(chunk, inpData, inSize):write_exact(inOutputFd, inpData, inSize);
+  };
+
+  uint32_t crc = CCRC32::update(CCRC32::INIT, inpHeader + 4, 4);
+  bool retVal = output(inpHeader, 8);
+  for (std::size_t remaining = dataSize; retVal && remaining > 0; )
+  {
+    const std::size_t blockSize = std::min(remaining, m_block.size());
+    retVal = read_exact(inInputFd, m_block.data(), blockSize) && output(m_block.data(), blockSize);
+    crc = CCRC32::update(crc, m_block.data(), blockSize);
+    remaining -= blockSize;
+  }
+
+  uint8_t chunkCRC[4];
+  retVal = retVal && read_exact(inInputFd, chunkCRC, sizeof(chunkCRC)) && output(chunkCRC, sizeof(chunkCRC));
+  if (!retVal)
+  {
+    std::cerr<<"Truncated or unwritable chunk"<<std::endl;
+  }
+  m_nbBadCRCs += (retVal && get_big_endian(chunkCRC) != (crc ^ CCRC32::INIT))? 1:0;
+
+  if (m_pStats)
+  {
+    m_pStats->m_nbCRCBytes += dataSize + 4;
+    m_pStats->m_peakPayloadBytes = std::max(m_pStats->m_peakPayloadBytes, m_memory.size() + m_block.size());
+  }
+  if (retVal && isBuffered)
+  {
+    m_bufferedChunks[inDataIndex] = chunk;
+  }
+  return retVal;
+} // copy_chunk
+
+////////////////////////////////////////////////////////////////////////////
+bool CStreamReorderer::append_to_buffer(SBufferedChunk& ioChunk, const uint8_t *inpData, const std::size_t inSize)
+{
+  bool retVal = true;
+  if (!ioChunk.m_isSpilled)
+  {
+    if (m_memory.size() < m_memorySize + inSize)
+    {
+      m_memory.resize(std::min(std::max(2 * m_memory.size(), m_memorySize + inSize), std::max(m_maxBufferedBytes, m_memorySize + inSize)));
+    }
+    std::memcpy(m_memory.data() + m_memorySize, inpData, inSize);
+    m_memorySize += inSize;
+  }
+  else
+  {
+    if (!m_pSpillFile)
+    {
+      m_pSpillFile = std::tmpfile();
+    }
+    retVal = (m_pSpillFile != nullptr);
+    const int spillFd = retVal? fileno(m_pSpillFile):-1;
+    for (std::size_t written = 0; retVal && written < inSize; )
+    {
+      const ssize_t nbWritten = pwrite(spillFd, inpData + written, inSize - written, m_spillSize + written);
+      retVal = (nbWritten > 0) || (nbWritten < 0 && errno == EINTR);
+      written += (nbWritten > 0)? nbWritten:0;
+    }
+    m_spillSize += inSize;
+    if (!retVal)
+    {
+      std::cerr<<"Cannot spill to a temporary file: "<<std::strerror(errno)<<std::endl;
+    }
+  }
+  ioChunk.m_size += inSize;
+  return retVal;
+} // append_to_buffer
+
+////////////////////////////////////////////////////////////////////////////
+bool CStreamReorderer::write_ready_chunks(const int inOutputFd)
+{
+  bool retVal = true;
+  while (retVal && m_nextOutput < m_newOrder.size())
+  {
+    auto itChunk = m_bufferedChunks.find(m_newOrder[m_nextOutput]);
+    if (itChunk == m_bufferedChunks.end())
+    {
+      break;
+    }
+    retVal = write_buffered_chunk(itChunk->second, inOutputFd);
+    m_bufferedChunks.erase(itChunk);
+    m_nextOutput++;
+  }
+
+  // the space is reused once everything pending is written
+  if (m_bufferedChunks.empty())
+  {
+    m_memorySize = 0;
+    m_spillSize = 0;
+  }
+  return retVal;
+} // write_ready_chunks
+
+////////////////////////////////////////////////////////////////////////////
+bool CStreamReorderer::write_all_buffered_chunks(const int inOutputFd)
+{
+  bool retVal = true;
+  for (const auto& chunk:m_bufferedChunks)
+  {
+    retVal = retVal && write_buffered_chunk(chunk.second, inOutputFd);
+  }
+  m_bufferedChunks.clear();
+  m_memorySize = 0;
+  m_spillSize = 0;
+  return retVal;
+} // write_all_buffered_chunks
+
+////////////////////////////////////////////////////////////////////////////
+bool CStreamReorderer::write_buffered_chunk(const SBufferedChunk& inChunk, const int inOutputFd)
+{
+  bool retVal = true;
+  if (!inChunk.m_isSpilled)
+  {
+    retVal = write_exact(inOutputFd, m_memory.data() + inChunk.m_offset, inChunk.m_size);
+  }
+  else
+  {
+    const int spillFd = fileno(m_pSpillFile);
+    for (std::size_t done = 0; retVal && done < inChunk.m_size; )
+    {
+      const ssize_t nbRead = pread(spillFd, m_block.data(), std::min(m_block.size(), inChunk.m_size - done), inChunk.m_offset + done);
+      if (nbRead > 0)
+      {
+        retVal = write_exact(inOutputFd, m_block.data(), nbRead);
+        done += nbRead;
+      }
+      else
+      {
+        retVal = (nbRead < 0 && errno == EINTR);
+      }
+    }
+  }
+  return retVal;
+} // write_buffered_chunk
+
+////////////////////////////////////////////////////////////////////////////
+bool CStreamReorderer::read_exact(const int inFd, uint8_t *outpData, const std::size_t inSize, bool *outpIsEnd)
+{
+  std::size_t done = 0;
+  bool retVal = true;
+  while (retVal && done < inSize)
+  {
+    const ssize_t nbRead = read(inFd, outpData + done, inSize - done);
+    if (nbRead > 0)
+    {
+      done += nbRead;
+    }
+    else if (nbRead < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      retVal = false;
+    }
+  }
+  if (outpIsEnd)
+  {
+    // nothing at all read: a clean end between two chunks
+    *outpIsEnd = !retVal && (done == 0);
+  }
+  if (m_pStats)
+  {
+    m_pStats->m_nbBytesRead += done;
+  }
+  return retVal;
+} // read_exact
+
+////////////////////////////////////////////////////////////////////////////
+bool CStreamReorderer::write_exact(const int inFd, const uint8_t *inpData, std::size_t inSize)
+{
+  bool retVal = true;
+  while (retVal && inSize > 0)
+  {
+    const ssize_t nbWritten = write(inFd, inpData, inSize);
+    if (nbWritten > 0)
+    {
+      inpData += nbWritten;
+      inSize -= nbWritten;
+      if (m_pStats)
+      {
+        m_pStats->m_nbBytesWritten += nbWritten;
+      }
+    }
+    else if (nbWritten < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      std::cerr<<"Write error: "<<std::strerror(errno)<<std::endl;
+      retVal = false;
+    }
+  }
+  return retVal;
+} // write_exact
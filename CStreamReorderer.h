@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CMemoryBudget.h"
+#include "CStats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Reorder the data chunks of a png read from a pipe, one chunk at a time.
+// Other chunks, and data chunks arriving in their output order, are written
+// as soon as they are read. Only the data chunks arriving early are
+// buffered: in memory up to a cap, then in an anonymous temporary file.
+// Damaged chunk headers cannot be resynchronized on a pipe: the stream
+// stops there.
+class CStreamReorderer
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    // An empty order copies the data chunks as they come.
+    CStreamReorderer(const std::vector<std::size_t>& inNewOrder, const std::size_t inMaxBufferedBytes);
+
+    ////////////////////////////////////////////////////////////////////////////
+    ~CStreamReorderer();
+
+    ////////////////////////////////////////////////////////////////////////////
+    CStreamReorderer(const CStreamReorderer&) = delete;
+    CStreamReorderer& operator=(const CStreamReorderer&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // False on I/O errors, a damaged stream, or an order not matching the
+    // data chunks (which are then written in their input order).
+    bool run(const int inInputFd, const int inOutputFd);
+
+    ////////////////////////////////////////////////////////////////////////////
+    void set_stats(SStats* inpStats);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // A chunk over the chunk cap, or a stream over the file cap, stops the
+    // stream at its header. The budget is not used: the buffering has its
+    // own cap.
+    void set_memory_limits(const SMemoryLimits& inLimits);
+
+  private:
+    struct SBufferedChunk
+    {
+      bool        m_isSpilled;
+      std::size_t m_offset;     // in memory or in the spill file
+      std::size_t m_size;       // header, data and CRC
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Copy the data and CRC of a chunk to the output, or to the buffer when
+    // inDataIndex is given.
+    bool copy_chunk(const int inInputFd, const int inOutputFd, const uint8_t *inpHeader, const std::size_t inDataIndex = SIZE_MAX);
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool append_to_buffer(SBufferedChunk& ioChunk, const uint8_t *inpData, const std::size_t inSize);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Write the buffered chunks next in the output order.
+    bool write_ready_chunks(const int inOutputFd);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Write the buffered chunks in their input order.
+    bool write_all_buffered_chunks(const int inOutputFd);
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool write_buffered_chunk(const SBufferedChunk& inChunk, const int inOutputFd);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // False at the end of the input, outIsEnd tells if it was expected.
+    bool read_exact(const int inFd, uint8_t *outpData, const std::size_t inSize, bool *outpIsEnd = nullptr);
+
+    ////////////////////////////////////////////////////////////////////////////
+    bool write_exact(const int inFd, const uint8_t *inpData, std::size_t inSize);
+
+    std::vector<std::size_t>                m_newOrder;
+    std::size_t                             m_maxBufferedBytes;
+    std::vector<uint8_t>                    m_memory;
+    std::size_t                             m_memorySize;
+    std::FILE                              *m_pSpillFile;
+    std::size_t                             m_spillSize;
+    std::map<std::size_t, SBufferedChunk>   m_bufferedChunks;     // by input data index
+    std::size_t                             m_nextOutput;         // position in m_newOrder
+    std::vector<uint8_t>                    m_block;
+    std::size_t                             m_nbBadCRCs;
+    SStats                                 *m_pStats;
+    SMemoryLimits                           m_limits;
+}; // class CStreamReorderer
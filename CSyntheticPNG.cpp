@@ -0,0 +1,156 @@
+#include "CSyntheticPNG.h"
+#include "CCRC32.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+constexpr uint8_t PNG_MAGIC_VALUE[] = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
+
+// ancillary types cycled through, with their size (0: the option size)
+struct SAncillaryType
+{
+  const char *m_pType;
+  std::size_t m_size;
+};
+constexpr SAncillaryType ANCILLARY_TYPES[] = {{"tEXt", 0}, {"pHYs", 9}, {"tIME", 7}, {"zTXt", 0},
+                                              {"gAMA", 4}, {"iTXt", 0}, {"cHRM", 32}, {"sPLT", 0}};
+constexpr std::size_t NB_ANCILLARY_TYPES = sizeof(ANCILLARY_TYPES) / sizeof(ANCILLARY_TYPES[0]);
+
+////////////////////////////////////////////////////////////////////////////
+void append_uint32(std::vector<uint8_t>& ioFile, const uint32_t inValue)
+{
+  for (int shift = 24; shift >= 0; shift -= 8)
+  {
+    ioFile.push_back(uint8_t(inValue >> shift));
+  }
+} // append_uint32
+}
+
+////////////////////////////////////////////////////////////////////////////
+std::vector<uint8_t> CSyntheticPNG::generate(const SSyntheticOptions& inOptions)
+{
+  using ECorruption = SSyntheticOptions::ECorruption;
+  std::vector<uint8_t> file(PNG_MAGIC_VALUE, PNG_MAGIC_VALUE + sizeof(PNG_MAGIC_VALUE));
+  uint64_t state = inOptions.m_seed;
+  std::size_t chunkCounter = 0;
+  const std::size_t period = std::max<std::size_t>(inOptions.m_corruptionPeriod, 1);
+  const bool canCorrupt = inOptions.m_corruption != ECorruption::NONE && inOptions.m_corruption != ECorruption::TRUNCATED;
+  auto append = [&](const char *inpType, const std::size_t inSize)
+  {
+    const bool isCorrupted = canCorrupt && (++chunkCounter % period == period / 2);
+    append_chunk(file, inpType, inSize, state, isCorrupted, inOptions.m_corruption);
+  };
+
+  const std::size_t nbAncillaryBefore = inOptions.m_nbAncillaryChunks - inOptions.m_nbAncillaryChunks / 3;
+  file.reserve(file.size() + 25 + 780 + inOptions.m_nbDataChunks * (inOptions.m_dataChunkSize + 12) +
+               inOptions.m_nbAncillaryChunks * (inOptions.m_ancillaryChunkSize + 44) + 12);
+
+  append_chunk(file, "IHDR", 13, state, false, ECorruption::NONE);
+  if (inOptions.m_hasPalette)
+  {
+    append("PLTE", 3 * 256);
+  }
+  for (std::size_t i = 0; i < nbAncillaryBefore; i++)
+  {
+    const SAncillaryType& type = ANCILLARY_TYPES[i % NB_ANCILLARY_TYPES];
+    append(type.m_pType, type.m_size > 0? type.m_size:inOptions.m_ancillaryChunkSize);
+  }
+  std::size_t lastDataChunk = file.size();
+  for (std::size_t i = 0; i < inOptions.m_nbDataChunks; i++)
+  {
+    lastDataChunk = file.size();
+    append("IDAT", inOptions.m_dataChunkSize);
+  }
+  for (std::size_t i = nbAncillaryBefore; i < inOptions.m_nbAncillaryChunks; i++)
+  {
+    append("tEXt", inOptions.m_ancillaryChunkSize);
+  }
+  append_chunk(file, "IEND", 0, state, false, ECorruption::NONE);
+
+  if (inOptions.m_corruption == ECorruption::TRUNCATED && inOptions.m_nbDataChunks > 0)
+  {
+    file.resize(lastDataChunk + 8 + inOptions.m_dataChunkSize / 2);
+  }
+  return file;
+} // generate
+
+////////////////////////////////////////////////////////////////////////////
+SSyntheticOptions CSyntheticPNG::get_options_for_size(const std::size_t inFileSize, const std::size_t inNbDataChunks)
+{
+  SSyntheticOptions options;
+  options.m_nbDataChunks = std::max<std::size_t>(inNbDataChunks, 1);
+  options.m_dataChunkSize = std::max<std::size_t>(inFileSize / options.m_nbDataChunks, 12) - 12;
+  return options;
+} // get_options_for_size
+
+////////////////////////////////////////////////////////////////////////////
+const char* CSyntheticPNG::get_corruption_name(const SSyntheticOptions::ECorruption inCorruption)
+{
+  using ECorruption = SSyntheticOptions::ECorruption;
+  switch (inCorruption)
+  {
+    case ECorruption::NONE:       return "none";
+    case ECorruption::BAD_CRC:    return "bad_crc";
+    case ECorruption::BAD_LENGTH: return "bad_length";
+    case ECorruption::GARBAGE:    return "garbage";
+    case ECorruption::TRUNCATED:  return "truncated";
+  }
+  return "unknown";
+} // get_corruption_name
+
+////////////////////////////////////////////////////////////////////////////
+void CSyntheticPNG::fill_random(uint8_t *outpData, const std::size_t inSize, uint64_t& ioState)
+{
+  std::size_t i = 0;
+  while (i < inSize)
+  {
+    ioState += 0x9e3779b97f4a7c15ull;
+    uint64_t value = ioState;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    value ^= value >> 31;
+    for (int k = 0; k < 8 && i < inSize; k++, i++)
+    {
+      outpData[i] = uint8_t(value >> (8 * k));
+    }
+  }
+} // fill_random
+
+////////////////////////////////////////////////////////////////////////////
+void CSyntheticPNG::append_chunk(std::vector<uint8_t>& ioFile, const char *inpType, const std::size_t inSize, uint64_t& ioState, const bool inIsCorrupted, const SSyntheticOptions::ECorruption inCorruption)
+{
+  using ECorruption = SSyntheticOptions::ECorruption;
+  const std::size_t start = ioFile.size();
+  append_uint32(ioFile, uint32_t(inSize));
+  ioFile.insert(ioFile.end(), inpType, inpType + 4);
+  ioFile.resize(ioFile.size() + inSize);
+  fill_random(ioFile.data() + start + 8, inSize, ioState);
+  uint32_t crc32 = CCRC32::compute(ioFile.data() + start + 4, inSize + 4);
+
+  if (inIsCorrupted)
+  {
+    switch (inCorruption)
+    {
+      case ECorruption::BAD_CRC:
+        crc32 = ~crc32;
+        break;
+      case ECorruption::BAD_LENGTH:
+        ioFile[start + 3] ^= 0x5a;
+        break;
+      default:
+        break;
+    }
+  }
+  append_uint32(ioFile, crc32);
+
+  if (inIsCorrupted && inCorruption == ECorruption::GARBAGE)
+  {
+    uint8_t garbageSize = 0;
+    fill_random(&garbageSize, 1, ioState);
+    const std::size_t garbageStart = ioFile.size();
+    ioFile.resize(garbageStart + 1 + garbageSize % 64);
+    fill_random(ioFile.data() + garbageStart, ioFile.size() - garbageStart, ioState);
+  }
+} // append_chunk
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+struct SSyntheticOptions
+{
+  // NONE: well-formed file
+  // BAD_CRC: some chunks have a wrong CRC
+  // BAD_LENGTH: some chunks have a wrong size field, the parser resyncs
+  // GARBAGE: random bytes are inserted between some chunks
+  // TRUNCATED: the file ends in the middle of the last data chunk
+  enum class ECorruption
+  {
+    NONE,
+    BAD_CRC,
+    BAD_LENGTH,
+    GARBAGE,
+    TRUNCATED
+  };
+
+  uint64_t    m_seed = 1;
+  std::size_t m_nbDataChunks = 4;
+  std::size_t m_dataChunkSize = 8192;
+  std::size_t m_nbAncillaryChunks = 3;
+  std::size_t m_ancillaryChunkSize = 64;
+  bool        m_hasPalette = false;
+  ECorruption m_corruption = ECorruption::NONE;
+  std::size_t m_corruptionPeriod = 16;         // one chunk out of N is corrupted
+}; // struct SSyntheticOptions
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Deterministic generator of PNG-like files: the same options give the same
+// bytes on every platform. Data chunks hold random bytes, not a valid zlib
+// stream, which is enough for everything but decoding.
+class CSyntheticPNG
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    static std::vector<uint8_t> generate(const SSyntheticOptions& inOptions);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Options giving a file of about inFileSize bytes in inNbDataChunks data
+    // chunks.
+    static SSyntheticOptions get_options_for_size(const std::size_t inFileSize, const std::size_t inNbDataChunks);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static const char* get_corruption_name(const SSyntheticOptions::ECorruption inCorruption);
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Random bytes from a splitmix64 sequence.
+    static void fill_random(uint8_t *outpData, const std::size_t inSize, uint64_t& ioState);
+
+    ////////////////////////////////////////////////////////////////////////////
+    static void append_chunk(std::vector<uint8_t>& ioFile, const char *inpType, const std::size_t inSize, uint64_t& ioState, const bool inIsCorrupted, const SSyntheticOptions::ECorruption inCorruption);
+}; // class CSyntheticPNG
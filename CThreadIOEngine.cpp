@@ -0,0 +1,37 @@
+#include "CThreadIOEngine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////
+CThreadIOEngine::CThreadIOEngine(const std::size_t inNbThreads)
+: m_pool(std::max<std::size_t>(inNbThreads, 1))
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CThreadIOEngine::~CThreadIOEngine()
+{
+  wait_idle();
+} // destructor
+
+////////////////////////////////////////////////////////////////////////////
+const char* CThreadIOEngine::get_backend_name() const
+{
+  return "threads";
+} // get_backend_name
+
+////////////////////////////////////////////////////////////////////////////
+void CThreadIOEngine::submit(SRequest *inpRequest)
+{
+  m_pool.submit([this, inpRequest]()
+                {
+                  uint8_t *pData = inpRequest->m_pData + inpRequest->m_nbDone;
+                  const std::size_t size = inpRequest->m_size - inpRequest->m_nbDone;
+                  const off_t offset = inpRequest->m_offset + inpRequest->m_nbDone;
+                  const ssize_t result = inpRequest->m_isWrite? pwrite(inpRequest->m_fd, pData, size, offset):
+                                                                pread(inpRequest->m_fd, pData, size, offset);
+                  on_transfer(inpRequest, result < 0? -errno:result);
+                });
+} // submit
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "CIOEngine.h"
+#include "CThreadPool.h"
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Blocking pread/pwrite on a pool of I/O threads, one request in flight per
+// thread. Portable fallback of the io_uring backend.
+class CThreadIOEngine : public CIOEngine
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    explicit CThreadIOEngine(const std::size_t inNbThreads);
+
+    ////////////////////////////////////////////////////////////////////////////
+    ~CThreadIOEngine() override;
+
+    ////////////////////////////////////////////////////////////////////////////
+    const char* get_backend_name() const override;
+
+  protected:
+    ////////////////////////////////////////////////////////////////////////////
+    void submit(SRequest *inpRequest) override;
+
+  private:
+    CThreadPool m_pool;
+}; // class CThreadIOEngine
@@ -0,0 +1,225 @@
+#include "CThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+
+// Pool and queue of the current thread when it is a worker.
+static thread_local const CThreadPool *s_pCurrentPool = nullptr;
+static thread_local std::size_t s_currentWorker = 0;
+
+////////////////////////////////////////////////////////////////////////////
+CThreadPool::CThreadPool(const std::size_t inNbThreads)
+: m_nbPendingTasks(0)
+, m_nbQueuedTasks(0)
+, m_nextQueue(0)
+, m_isStopping(false)
+{
+  std::size_t nbThreads = inNbThreads;
+  if (nbThreads == 0)
+  {
+    nbThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (std::size_t i = 0; i < nbThreads; i++)
+  {
+    m_queues.emplace_back(new SWorkerQueue);
+  }
+  for (std::size_t i = 0; i < nbThreads; i++)
+  {
+    m_threads.emplace_back(&CThreadPool::worker_loop, this, i);
+  }
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+CThreadPool::~CThreadPool()
+{
+  wait_idle();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_tasksCondition.notify_all();
+  for (auto& thread:m_threads)
+  {
+    thread.join();
+  }
+} // destructor
+
+////////////////////////////////////////////////////////////////////////////
+void CThreadPool::submit(task&& inTask)
+{
+  std::size_t queueIndex;
+  if (s_pCurrentPool == this)
+  {
+    queueIndex = s_currentWorker;
+  }
+  else
+  {
+    queueIndex = m_nextQueue++ % m_queues.size();
+  }
+
+  // counted before being pushed: the count never misses a queued task, a
+  // worker seeing it while the push is on going only retries its pop
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nbPendingTasks++;
+    m_nbQueuedTasks++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_queues[queueIndex]->m_mutex);
+    m_queues[queueIndex]->m_tasks.push_back(std::move(inTask));
+  }
+  m_tasksCondition.notify_one();
+} // submit
+
+////////////////////////////////////////////////////////////////////////////
+void CThreadPool::wait_idle()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idleCondition.wait(lock, [this](){ return m_nbPendingTasks == 0; });
+} // wait_idle
+
+////////////////////////////////////////////////////////////////////////////
+void CThreadPool::parallel_for(const std::size_t inNbTasks, const std::function<void(std::size_t)>& inTask)
+{
+  // the indices are claimed from the call's own counter by the caller and
+  // by helper tasks: a nested wait never runs unrelated pool tasks
+  struct SState
+  {
+    std::atomic<std::size_t> m_nextIndex;
+    std::mutex               m_mutex;
+    std::condition_variable  m_doneCondition;
+    std::size_t              m_nbRemaining;
+    std::exception_ptr       m_pException;
+  };
+  auto pState = std::make_shared<SState>();
+  pState->m_nextIndex = 0;
+  pState->m_nbRemaining = inNbTasks;
+
+  // a late helper finds no index left and does not touch inTask
+  const auto run_indices = [pState, &inTask, inNbTasks]()
+                           {
+                             for (std::size_t i = pState->m_nextIndex++; i < inNbTasks; i = pState->m_nextIndex++)
+                             {
+                               std::exception_ptr pException;
+                               try
+                               {
+                                 inTask(i);
+                               }
+                               catch (...)
+                               {
+                                 pException = std::current_exception();
+                               }
+                               // counted down whatever happened, the caller waits for it
+                               std::lock_guard<std::mutex> lock(pState->m_mutex);
+                               if (pException && !pState->m_pException)
+                               {
+                                 pState->m_pException = pException;
+                               }
+                               if (--pState->m_nbRemaining == 0)
+                               {
+                                 pState->m_doneCondition.notify_all();
+                               }
+                             }
+                           };
+
+  // the caller is one of the runners
+  const std::size_t nbHelpers = (inNbTasks > 0)? std::min(inNbTasks - 1, m_threads.size()):0;
+  for (std::size_t i = 0; i < nbHelpers; i++)
+  {
+    submit(run_indices);
+  }
+  run_indices();
+
+  // the indices left are being run by helpers
+  std::unique_lock<std::mutex> lock(pState->m_mutex);
+  pState->m_doneCondition.wait(lock, [&pState]() { return pState->m_nbRemaining == 0; });
+  if (pState->m_pException)
+  {
+    std::rethrow_exception(pState->m_pException);
+  }
+} // parallel_for
+
+////////////////////////////////////////////////////////////////////////////
+std::size_t CThreadPool::get_nb_threads() const
+{
+  return m_threads.size();
+} // get_nb_threads
+
+////////////////////////////////////////////////////////////////////////////
+CThreadPool& CThreadPool::get_default()
+{
+  static CThreadPool pool;
+  return pool;
+} // get_default
+
+////////////////////////////////////////////////////////////////////////////
+void CThreadPool::worker_loop(const std::size_t inIndex)
+{
+  s_pCurrentPool = this;
+  s_currentWorker = inIndex;
+
+  while (true)
+  {
+    task localTask;
+    if (pop_task(inIndex, localTask))
+    {
+      run_task(localTask);
+    }
+    else
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      // the count is updated under the lock: no wakeup is lost
+      m_tasksCondition.wait(lock, [this]() { return m_isStopping || m_nbQueuedTasks > 0; });
+      if (m_isStopping && m_nbQueuedTasks == 0)
+      {
+        break;
+      }
+    }
+  }
+} // worker_loop
+
+////////////////////////////////////////////////////////////////////////////
+bool CThreadPool::pop_task(const std::size_t inIndex, task& outTask)
+{
+  bool retVal = false;
+  {
+    SWorkerQueue& queue = *m_queues[inIndex];
+    std::lock_guard<std::mutex> lock(queue.m_mutex);
+    if (!queue.m_tasks.empty())
+    {
+      outTask = std::move(queue.m_tasks.back());
+      queue.m_tasks.pop_back();
+      retVal = true;
+    }
+  }
+
+  for (std::size_t i = 1; !retVal && i < m_queues.size(); i++)
+  {
+    SWorkerQueue& queue = *m_queues[(inIndex + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(queue.m_mutex);
+    if (!queue.m_tasks.empty())
+    {
+      outTask = std::move(queue.m_tasks.front());
+      queue.m_tasks.pop_front();
+      retVal = true;
+    }
+  }
+  if (retVal)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nbQueuedTasks--;
+  }
+  return retVal;
+} // pop_task
+
+////////////////////////////////////////////////////////////////////////////
+void CThreadPool::run_task(task& ioTask)
+{
+  ioTask();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (--m_nbPendingTasks == 0)
+  {
+    m_idleCondition.notify_all();
+  }
+} // run_task
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Fixed-size work-stealing thread pool: every worker owns a deque, pops its
+// own tasks from the back and steals from the front of the others.
+class CThreadPool
+{
+  public:
+    using task = std::function<void()>;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // inNbThreads == 0 means one thread per hardware thread.
+    explicit CThreadPool(const std::size_t inNbThreads = 0);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Run the remaining tasks then join the workers.
+    ~CThreadPool();
+
+    ////////////////////////////////////////////////////////////////////////////
+    CThreadPool(const CThreadPool&) = delete;
+    CThreadPool& operator=(const CThreadPool&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // From a worker the task goes to its own deque, else round robin.
+    void submit(task&& inTask);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Block until every submitted task is done.
+    void wait_idle();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Run inTask(0..inNbTasks-1) on the pool and wait for them. The calling
+    // thread runs indices too, and only the indices of this call, so it can
+    // be nested in a pool task without running unrelated tasks on its stack.
+    // The first exception thrown by a task is rethrown once all are done.
+    void parallel_for(const std::size_t inNbTasks, const std::function<void(std::size_t)>& inTask);
+
+    ////////////////////////////////////////////////////////////////////////////
+    std::size_t get_nb_threads() const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Shared process-wide pool, created on first use.
+    static CThreadPool& get_default();
+
+  private:
+    struct SWorkerQueue
+    {
+      std::mutex       m_mutex;
+      std::deque<task> m_tasks;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    void worker_loop(const std::size_t inIndex);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Own deque back first, then steal other fronts.
+    bool pop_task(const std::size_t inIndex, task& outTask);
+
+    ////////////////////////////////////////////////////////////////////////////
+    void run_task(task& ioTask);
+
+    std::vector<std::unique_ptr<SWorkerQueue>> m_queues;
+    std::vector<std::thread>                   m_threads;
+    std::mutex                                 m_mutex;
+    std::condition_variable                    m_tasksCondition;
+    std::condition_variable                    m_idleCondition;
+    std::size_t                                m_nbPendingTasks;   // queued or running
+    std::size_t                                m_nbQueuedTasks;    // wakes the workers
+    std::atomic<std::size_t>                   m_nextQueue;
+    bool                                       m_isStopping;
+}; // class CThreadPool
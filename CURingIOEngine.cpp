@@ -0,0 +1,273 @@
+#include "CURingIOEngine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <vector>
+
+// The reaper wakes up at least this often to see a failure of a submit.
+constexpr long long REAPER_TICK_SECONDS = 1;
+
+// Ticks without any completion after which the requests still in flight on
+// a failed ring are given up.
+constexpr std::size_t DRAIN_TIMEOUT_TICKS = 10;
+
+////////////////////////////////////////////////////////////////////////////
+CURingIOEngine::CURingIOEngine(const std::size_t inQueueDepth)
+: m_queueDepth(inQueueDepth)
+, m_error(0)
+{
+} // constructor
+
+////////////////////////////////////////////////////////////////////////////
+std::unique_ptr<CIOEngine> CURingIOEngine::create(const std::size_t inQueueDepth)
+{
+  std::unique_ptr<CURingIOEngine> pEngine(new CURingIOEngine(std::max<std::size_t>(inQueueDepth, 1)));
+  // one more entry for the stop request of the destructor
+  struct io_uring_params params = {};
+  if (io_uring_queue_init_params(pEngine->m_queueDepth + 1, &pEngine->m_ring, &params) == 0)
+  {
+    // without EXT_ARG, a wait with a timeout takes an SQE behind the back
+    // of the submitters
+    if (params.features & IORING_FEAT_EXT_ARG)
+    {
+      pEngine->m_reaper = std::thread(&CURingIOEngine::reaper_loop, pEngine.get());
+    }
+    else
+    {
+      io_uring_queue_exit(&pEngine->m_ring);
+      pEngine.reset();
+    }
+  }
+  else
+  {
+    pEngine.reset();
+  }
+  return pEngine;
+} // create
+
+////////////////////////////////////////////////////////////////////////////
+CURingIOEngine::~CURingIOEngine()
+{
+  wait_idle();
+  {
+    // a null user data stops the reaper, which stops by itself once a
+    // failed ring is drained
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    struct io_uring_sqe *pSqe = (m_error == 0)? io_uring_get_sqe(&m_ring):nullptr;
+    if (pSqe != nullptr)
+    {
+      io_uring_prep_nop(pSqe);
+      io_uring_sqe_set_data(pSqe, nullptr);
+      m_error = submit_ring();
+    }
+  }
+  m_reaper.join();
+  io_uring_queue_exit(&m_ring);
+} // destructor
+
+////////////////////////////////////////////////////////////////////////////
+const char* CURingIOEngine::get_backend_name() const
+{
+  return "io_uring";
+} // get_backend_name
+
+////////////////////////////////////////////////////////////////////////////
+void CURingIOEngine::submit(SRequest *inpRequest)
+{
+  int error = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    if (m_error != 0)
+    {
+      error = m_error;
+    }
+    else if (m_inFlightRequests.size() < m_queueDepth)
+    {
+      queue_in_ring(inpRequest);
+      // the reaper drains the ring, this request included
+      m_error = submit_ring();
+    }
+    else
+    {
+      m_waitingRequests.push_back(inpRequest);
+    }
+  }
+  // out of the lock: the completion may submit again
+  if (error != 0)
+  {
+    on_transfer(inpRequest, error);
+  }
+} // submit
+
+////////////////////////////////////////////////////////////////////////////
+void CURingIOEngine::queue_in_ring(SRequest *inpRequest)
+{
+  // never null: at most m_queueDepth requests are in the ring
+  struct io_uring_sqe *pSqe = io_uring_get_sqe(&m_ring);
+  uint8_t *pData = inpRequest->m_pData + inpRequest->m_nbDone;
+  const unsigned size = std::min<std::size_t>(inpRequest->m_size - inpRequest->m_nbDone, 1u << 30);
+  const off_t offset = inpRequest->m_offset + inpRequest->m_nbDone;
+  if (inpRequest->m_isWrite)
+  {
+    io_uring_prep_write(pSqe, inpRequest->m_fd, pData, size, offset);
+  }
+  else
+  {
+    io_uring_prep_read(pSqe, inpRequest->m_fd, pData, size, offset);
+  }
+  io_uring_sqe_set_data(pSqe, inpRequest);
+  m_inFlightRequests.insert(inpRequest);
+} // queue_in_ring
+
+////////////////////////////////////////////////////////////////////////////
+int CURingIOEngine::submit_ring()
+{
+  int retVal = 0;
+  // a partial submit leaves the next SQEs in the ring
+  while (retVal == 0 && io_uring_sq_ready(&m_ring) > 0)
+  {
+    const int result = io_uring_submit(&m_ring);
+    if (result < 0 && result != -EINTR)
+    {
+      // a retried error would be submitted again forever
+      retVal = (result == -EAGAIN)? -EIO:result;
+    }
+  }
+  return retVal;
+} // submit_ring
+
+////////////////////////////////////////////////////////////////////////////
+void CURingIOEngine::reaper_loop()
+{
+  bool isStopping = false;
+  bool isDraining = false;
+  std::size_t nbIdleTicks = 0;
+  while (!isStopping)
+  {
+    struct io_uring_cqe *pCqe = nullptr;
+    struct __kernel_timespec tick = {REAPER_TICK_SECONDS, 0};
+    const int error = io_uring_wait_cqe_timeout(&m_ring, &pCqe, &tick);
+    if (error == 0)
+    {
+      void *pData = io_uring_cqe_get_data(pCqe);
+      const ssize_t result = pCqe->res;
+      io_uring_cqe_seen(&m_ring, pCqe);
+      nbIdleTicks = 0;
+
+      if (pData == nullptr)
+      {
+        isStopping = true;
+      }
+      else if (pData != &m_ring)
+      {
+        SRequest *pRequest = (SRequest*)pData;
+        {
+          std::lock_guard<std::mutex> lock(m_ringMutex);
+          m_inFlightRequests.erase(pRequest);
+          bool isQueued = false;
+          while (m_error == 0 && !m_waitingRequests.empty() && m_inFlightRequests.size() < m_queueDepth)
+          {
+            queue_in_ring(m_waitingRequests.front());
+            m_waitingRequests.pop_front();
+            isQueued = true;
+          }
+          if (isQueued)
+          {
+            m_error = submit_ring();
+          }
+        }
+        // may resubmit a short transfer, which fails at once on a failed ring
+        on_transfer(pRequest, result);
+      }
+    }
+    else if (error == -ETIME)
+    {
+      nbIdleTicks++;
+    }
+    else if (error != -EINTR)
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        if (m_error == 0)
+        {
+          m_error = (error == -EAGAIN)? -EIO:error;
+        }
+      }
+      // a failing wait returns at once, it counts as a tick
+      std::this_thread::sleep_for(std::chrono::seconds(REAPER_TICK_SECONDS));
+      nbIdleTicks++;
+    }
+
+    if (!isStopping)
+    {
+      int ringError = 0;
+      {
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        ringError = m_error;
+      }
+      if (ringError != 0 && !isDraining)
+      {
+        isDraining = true;
+        nbIdleTicks = 0;
+        start_drain(ringError);
+      }
+      if (isDraining)
+      {
+        isStopping = drain(ringError, nbIdleTicks >= DRAIN_TIMEOUT_TICKS);
+      }
+    }
+  }
+} // reaper_loop
+
+////////////////////////////////////////////////////////////////////////////
+void CURingIOEngine::start_drain(const int inError)
+{
+  std::vector<SRequest*> requests;
+  {
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    // the kernel never saw the waiting requests
+    requests.assign(m_waitingRequests.begin(), m_waitingRequests.end());
+    m_waitingRequests.clear();
+
+    // the ring address tags the completions of the cancels
+    for (SRequest *pRequest : m_inFlightRequests)
+    {
+      struct io_uring_sqe *pSqe = io_uring_get_sqe(&m_ring);
+      if (pSqe != nullptr)
+      {
+        io_uring_prep_cancel(pSqe, pRequest, 0);
+        io_uring_sqe_set_data(pSqe, &m_ring);
+      }
+    }
+    submit_ring();
+  }
+  for (SRequest *pRequest : requests)
+  {
+    on_transfer(pRequest, inError);
+  }
+} // start_drain
+
+////////////////////////////////////////////////////////////////////////////
+bool CURingIOEngine::drain(const int inError, const bool inIsTimedOut)
+{
+  std::vector<SRequest*> requests;
+  bool retVal = false;
+  {
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    if (inIsTimedOut)
+    {
+      // no completion will come for them: dropped on a CQ overflow, or
+      // their SQEs were never consumed
+      requests.assign(m_inFlightRequests.begin(), m_inFlightRequests.end());
+      m_inFlightRequests.clear();
+    }
+    retVal = m_inFlightRequests.empty();
+  }
+  // wait_idle and the callers waiting for these completions are released
+  for (SRequest *pRequest : requests)
+  {
+    on_transfer(pRequest, inError);
+  }
+  return retVal;
+} // drain
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "CIOEngine.h"
+
+#include <deque>
+#include <liburing.h>
+#include <thread>
+#include <unordered_set>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// io_uring backend: requests are queued in the ring up to its depth, the
+// others wait in submission order. A reaper thread collects the
+// completions and refills the ring.
+// When a submit or a wait fails, the requests in flight are cancelled and
+// drained: each completes when the kernel gives it back, so its memory is
+// not freed under a transfer. The requests still in flight after the drain
+// timeout are given up with the error, like the waiting ones and the ones
+// submitted later.
+// Needs IORING_FEAT_EXT_ARG (Linux 5.11): the reaper waits with a timeout.
+class CURingIOEngine : public CIOEngine
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    // nullptr when the kernel refuses the ring (old kernel, seccomp...).
+    static std::unique_ptr<CIOEngine> create(const std::size_t inQueueDepth);
+
+    ////////////////////////////////////////////////////////////////////////////
+    ~CURingIOEngine() override;
+
+    ////////////////////////////////////////////////////////////////////////////
+    const char* get_backend_name() const override;
+
+  protected:
+    ////////////////////////////////////////////////////////////////////////////
+    void submit(SRequest *inpRequest) override;
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    explicit CURingIOEngine(const std::size_t inQueueDepth);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Called with m_ringMutex held.
+    void queue_in_ring(SRequest *inpRequest);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Called with m_ringMutex held. Submit every queued SQE, 0 or -errno.
+    int submit_ring();
+
+    ////////////////////////////////////////////////////////////////////////////
+    void reaper_loop();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // The ring failed with inError: complete the waiting requests and cancel
+    // the ones in flight.
+    void start_drain(const int inError);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // True when nothing is left in flight. inIsTimedOut gives up the
+    // requests still in flight.
+    bool drain(const int inError, const bool inIsTimedOut);
+
+    struct io_uring                 m_ring;
+    std::size_t                     m_queueDepth;
+    std::mutex                      m_ringMutex;
+    std::deque<SRequest*>           m_waitingRequests;
+    std::unordered_set<SRequest*>   m_inFlightRequests;
+    int                             m_error;              // -errno of the ring failure, 0 while it works
+    std::thread                     m_reaper;
+}; // class CURingIOEngine
@@ -0,0 +1,152 @@
+#include "CZlib.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// Deflate window, the dictionary of a block.
+constexpr std::size_t WINDOW_SIZE = 32768;
+
+// First size of the inflate output, then doubled.
+constexpr std::size_t INFLATE_STEP = 1 << 20;
+
+////////////////////////////////////////////////////////////////////////////
+bool CZlib::inflate(const std::vector<std::span<const uint8_t>>& inParts, std::vector<uint8_t>& outData,
+                    const growFunction& inCanGrow)
+{
+  z_stream stream = {};
+  bool retVal = (inflateInit(&stream) == Z_OK);
+  bool isEnd = false;
+  std::size_t size = 0;
+  outData.clear();
+
+  for (std::size_t i = 0; retVal && !isEnd && i < inParts.size(); i++)
+  {
+    stream.next_in = const_cast<Bytef*>(inParts[i].data());
+    stream.avail_in = inParts[i].size();
+    // a full output may hide pending bytes even with all the input read
+    while (retVal && !isEnd && (stream.avail_in > 0 || stream.avail_out == 0))
+    {
+      if (size == outData.size())
+      {
+        const std::size_t growth = std::max(size, INFLATE_STEP);
+        retVal = inCanGrow(growth);
+        outData.resize(retVal? size + growth:size);
+      }
+      if (retVal)
+      {
+        stream.next_out = outData.data() + size;
+        stream.avail_out = std::min<std::size_t>(outData.size() - size, UINT32_MAX);
+        const int result = ::inflate(&stream, Z_NO_FLUSH);
+        size = stream.next_out - outData.data();
+        isEnd = (result == Z_STREAM_END);
+        // Z_BUF_ERROR: no progress possible, the next part is needed
+        retVal = (result == Z_OK || isEnd || result == Z_BUF_ERROR);
+      }
+    }
+  }
+  inflateEnd(&stream);
+  outData.resize(size);
+
+  return retVal && isEnd;
+} // inflate
+
+////////////////////////////////////////////////////////////////////////////
+bool CZlib::deflate_parallel(std::span<const uint8_t> inData, const int inLevel, const std::size_t inBlockSize,
+                             std::vector<uint8_t>& outStream, CThreadPool& ioPool)
+{
+  const std::size_t nbBlocks = std::max<std::size_t>((inData.size() + inBlockSize - 1) / inBlockSize, 1);
+  std::vector<std::vector<uint8_t>> blocks(nbBlocks);
+  std::vector<uLong> adlers(nbBlocks);
+  std::vector<char> isBlockOk(nbBlocks, false);
+
+  ioPool.parallel_for(nbBlocks, [&](const std::size_t inBlock)
+                                {
+                                  const std::size_t start = inBlock * inBlockSize;
+                                  const std::size_t size = std::min(inBlockSize, inData.size() - start);
+                                  const std::size_t dictionarySize = std::min(start, WINDOW_SIZE);
+                                  isBlockOk[inBlock] = deflate_block(inData.subspan(start, size),
+                                                                     inData.subspan(start - dictionarySize, dictionarySize),
+                                                                     inLevel, inBlock + 1 == nbBlocks, blocks[inBlock]);
+                                  adlers[inBlock] = adler32_z(adler32(0, Z_NULL, 0), inData.data() + start, size);
+                                });
+
+  bool retVal = std::all_of(isBlockOk.begin(), isBlockOk.end(), [](const char inIsOk) { return inIsOk; });
+  if (retVal)
+  {
+    // header: 32K window, no preset dictionary, level hint
+    const uint8_t cmf = 0x78;
+    const uint8_t levelFlag = (inLevel == 6)? 2:(inLevel > 6)? 3:(inLevel > 1)? 1:0;
+    uint8_t flg = levelFlag << 6;
+    flg += 31 - (cmf * 256 + flg) % 31;
+
+    std::size_t streamSize = 2 + 4;
+    for (const auto& block:blocks)
+    {
+      streamSize += block.size();
+    }
+    outStream.clear();
+    outStream.reserve(streamSize);
+    outStream.push_back(cmf);
+    outStream.push_back(flg);
+
+    uLong adler = adlers[0];
+    outStream.insert(outStream.end(), blocks[0].begin(), blocks[0].end());
+    for (std::size_t i = 1; i < nbBlocks; i++)
+    {
+      const std::size_t size = std::min(inBlockSize, inData.size() - i * inBlockSize);
+      adler = adler32_combine(adler, adlers[i], size);
+      outStream.insert(outStream.end(), blocks[i].begin(), blocks[i].end());
+    }
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+      outStream.push_back(uint8_t(adler >> shift));
+    }
+  }
+
+  return retVal;
+} // deflate_parallel
+
+////////////////////////////////////////////////////////////////////////////
+bool CZlib::deflate_block(std::span<const uint8_t> inBlock, std::span<const uint8_t> inDictionary, const int inLevel,
+                          const bool inIsLast, std::vector<uint8_t>& outData)
+{
+  z_stream stream = {};
+  bool retVal = (deflateInit2(&stream, inLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+  if (retVal && !inDictionary.empty())
+  {
+    retVal = (deflateSetDictionary(&stream, inDictionary.data(), inDictionary.size()) == Z_OK);
+  }
+
+  if (retVal)
+  {
+    // the sync flush marker is not counted by deflateBound
+    outData.resize(deflateBound(&stream, inBlock.size()) + 16);
+    stream.next_in = const_cast<Bytef*>(inBlock.data());
+    stream.avail_in = inBlock.size();
+    stream.next_out = outData.data();
+    stream.avail_out = outData.size();
+
+    // a sync flush ends the block on a byte boundary without the final bit
+    const int flush = inIsLast? Z_FINISH:Z_SYNC_FLUSH;
+    bool isDone = false;
+    while (retVal && !isDone)
+    {
+      if (stream.avail_out == 0)
+      {
+        const std::size_t size = outData.size();
+        outData.resize(2 * size);
+        stream.next_out = outData.data() + size;
+        stream.avail_out = outData.size() - size;
+      }
+      const int result = ::deflate(&stream, flush);
+      retVal = (result == Z_OK || result == Z_STREAM_END || result == Z_BUF_ERROR);
+      isDone = inIsLast? (result == Z_STREAM_END):(stream.avail_in == 0 && stream.avail_out != 0);
+    }
+    outData.resize(outData.size() - stream.avail_out);
+  }
+  deflateEnd(&stream);
+
+  return retVal;
+} // deflate_block
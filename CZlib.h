@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// The zlib stream carried by the data chunks.
+class CZlib
+{
+  public:
+    ////////////////////////////////////////////////////////////////////////////
+    // Called before the output grows by inNbMoreBytes, false stops.
+    using growFunction = std::function<bool(const std::size_t inNbMoreBytes)>;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Inflate a zlib stream given in parts (the data of consecutive chunks)
+    // without joining them. False on a damaged or truncated stream, or when
+    // inCanGrow refused more memory.
+    static bool inflate(const std::vector<std::span<const uint8_t>>& inParts, std::vector<uint8_t>& outData,
+                        const growFunction& inCanGrow);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // pigz-style: inData is cut in blocks of inBlockSize deflated in
+    // parallel on ioPool. Each block is primed with the last 32 KiB of the
+    // previous one as dictionary, so the ratio stays close to a serial
+    // deflate, and ends on a byte boundary (sync flush) so the raw outputs
+    // concatenate into one stream. The adler-32 is combined from the ones
+    // of the blocks.
+    static bool deflate_parallel(std::span<const uint8_t> inData, const int inLevel, const std::size_t inBlockSize,
+                                 std::vector<uint8_t>& outStream, CThreadPool& ioPool);
+
+  private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Raw deflate of one block, inDictionary may be empty.
+    static bool deflate_block(std::span<const uint8_t> inBlock, std::span<const uint8_t> inDictionary, const int inLevel,
+                              const bool inIsLast, std::vector<uint8_t>& outData);
+}; // class CZlib
@@ -0,0 +1,353 @@
+#include "CPNG.h"
+#include "CCRC32.h"
+#include "CByteBuffer.h"
+#include "CSyntheticPNG.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+
+using ECorruption = SSyntheticOptions::ECorruption;
+
+struct SBenchCase
+{
+  std::string       m_name;
+  SSyntheticOptions m_options;
+};
+
+struct SMeasure
+{
+  std::string m_name;
+  double      m_bestNs = 0.;
+  double      m_meanNs = 0.;
+  std::size_t m_nbBytes = 0;
+  std::size_t m_nbChunks = 0;
+};
+
+struct SBenchOptions
+{
+  std::size_t              m_nbIterations = 5;
+  double                   m_scale = 1.;
+  uint64_t                 m_seed = 1;
+  std::vector<std::string> m_cases;             // empty: all
+  std::string              m_label;
+  std::string              m_outName;           // empty: stdout
+  std::string              m_corpusDir;         // empty: temporary files
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void print_syntax(const char* inpProgName)
+{
+  std::cout<<"Syntax: "<<inpProgName<<" [--iterations N] [--scale F] [--seed S] [--case NAME]... [--label TEXT] [--output file.json] [--corpus DIR] [--list]"<<std::endl;
+  std::cout<<"  --scale multiplies every file size (--scale 16 turns large_64MB into 1GB)"<<std::endl;
+  std::cout<<"  --corpus keeps the generated files in DIR"<<std::endl;
+} // print_syntax
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static std::vector<SBenchCase> get_cases(const SBenchOptions& inOptions)
+{
+  // name, file size, data chunks, ancillary chunks, ancillary size, palette, corruption
+  struct SCaseDesc
+  {
+    const char *m_pName;
+    std::size_t m_fileSize;
+    std::size_t m_nbDataChunks;
+    std::size_t m_nbAncillaryChunks;
+    std::size_t m_ancillaryChunkSize;
+    bool        m_hasPalette;
+    ECorruption m_corruption;
+  };
+  static const SCaseDesc CASES[] = {
+    {"small_64KB",      64ull << 10,  4,   3,   64,  false, ECorruption::NONE},
+    {"medium_8MB",      8ull << 20,   64,  16,  256, true,  ECorruption::NONE},
+    {"many_chunks_4MB", 4ull << 20,   512, 256, 100, false, ECorruption::NONE},
+    {"large_64MB",      64ull << 20,  32,  8,   256, false, ECorruption::NONE},
+    {"bad_crc_8MB",     8ull << 20,   64,  16,  256, false, ECorruption::BAD_CRC},
+    {"bad_length_8MB",  8ull << 20,   64,  16,  256, false, ECorruption::BAD_LENGTH},
+    {"garbage_8MB",     8ull << 20,   64,  16,  256, false, ECorruption::GARBAGE},
+    {"truncated_8MB",   8ull << 20,   64,  16,  256, false, ECorruption::TRUNCATED}
+  };
+
+  std::vector<SBenchCase> cases;
+  for (const auto& desc:CASES)
+  {
+    const bool isSelected = inOptions.m_cases.empty() ||
+                            std::find(inOptions.m_cases.begin(), inOptions.m_cases.end(), desc.m_pName) != inOptions.m_cases.end();
+    if (isSelected)
+    {
+      SBenchCase benchCase;
+      benchCase.m_name = desc.m_pName;
+      benchCase.m_options = CSyntheticPNG::get_options_for_size(std::size_t(desc.m_fileSize * inOptions.m_scale), desc.m_nbDataChunks);
+      benchCase.m_options.m_seed = inOptions.m_seed;
+      benchCase.m_options.m_nbAncillaryChunks = desc.m_nbAncillaryChunks;
+      benchCase.m_options.m_ancillaryChunkSize = desc.m_ancillaryChunkSize;
+      benchCase.m_options.m_hasPalette = desc.m_hasPalette;
+      benchCase.m_options.m_corruption = desc.m_corruption;
+      cases.push_back(benchCase);
+    }
+  }
+  return cases;
+} // get_cases
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// inSetup is not timed, inRun is.
+static SMeasure measure(const std::string& inName, const std::size_t inNbIterations,
+                        const std::function<void()>& inSetup, const std::function<void()>& inRun)
+{
+  SMeasure retVal;
+  retVal.m_name = inName;
+  retVal.m_bestNs = std::numeric_limits<double>::max();
+  double totalNs = 0.;
+  for (std::size_t i = 0; i < inNbIterations; i++)
+  {
+    inSetup();
+    const auto start = std::chrono::steady_clock::now();
+    inRun();
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    retVal.m_bestNs = std::min(retVal.m_bestNs, ns);
+    totalNs += ns;
+  }
+  retVal.m_meanNs = totalNs / std::max<std::size_t>(inNbIterations, 1);
+  return retVal;
+} // measure
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static std::string escape_json(const std::string& inText)
+{
+  std::string retVal;
+  for (char c:inText)
+  {
+    if (c == '"' || c == '\\')
+    {
+      retVal += '\\';
+    }
+    if (uint8_t(c) >= 0x20)
+    {
+      retVal += c;
+    }
+  }
+  return retVal;
+} // escape_json
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static std::vector<SMeasure> run_case(const SBenchCase& inCase, const SBenchOptions& inOptions,
+                                      const std::filesystem::path& inDir, std::size_t& outFileSize, std::size_t& outNbChunks)
+{
+  std::vector<SMeasure> measures;
+  const std::size_t nbIterations = inOptions.m_nbIterations;
+  sharedByteBuffer pFile = CByteBuffer::create(CSyntheticPNG::generate(inCase.m_options));
+  const uint8_t *pData = pFile->get_data();
+  const std::size_t fileSize = pFile->get_size();
+  const std::filesystem::path inName = inDir / (inCase.m_name + ".png");
+  const std::filesystem::path outName = inDir / (inCase.m_name + "_bench_out.png");
+  {
+    std::ofstream file(inName, std::ios::binary);
+    file.write((const char*)pData, fileSize);
+  }
+
+  // CCRC32::compute over the whole file
+  CPNG reference;
+  reference.load_chunks_from_buffer(pFile, 8);
+  const std::size_t nbChunks = reference.get_nb_chunks();
+  volatile uint32_t crc32Sink = 0;
+  measures.push_back(measure("crc32_compute", nbIterations, []{}, [&]{ crc32Sink = CCRC32::compute(pData, fileSize); }));
+  measures.back().m_nbBytes = fileSize;
+  measures.back().m_nbChunks = nbChunks;
+
+  // load_chunks_from_buffer, zero-copy
+  std::unique_ptr<CPNG> pPNG;
+  measures.push_back(measure("load_chunks_from_buffer", nbIterations,
+                             [&]{ pPNG = std::make_unique<CPNG>(); },
+                             [&]{ pPNG->load_chunks_from_buffer(pFile, 8); }));
+  measures.back().m_nbBytes = fileSize;
+  measures.back().m_nbChunks = nbChunks;
+
+  // find_next_chunk hopping over every chunk type of the file
+  std::size_t nbFound = 0;
+  measures.push_back(measure("find_next_chunk", nbIterations, [&]{ nbFound = 0; },
+                             [&]{
+                               for (std::size_t index = reference.find_next_chunk(pData, fileSize, 8);
+                                    index < fileSize;
+                                    index = reference.find_next_chunk(pData, fileSize, index + 8))
+                               {
+                                 nbFound++;
+                               }
+                             }));
+  measures.back().m_nbBytes = fileSize;
+  measures.back().m_nbChunks = nbFound;
+
+  // reorder_data_chunks with the reversed order
+  chunkIterator firstIt;
+  chunkIterator lastIt;
+  std::vector<std::size_t> newOrder;
+  if (reference.get_data_range(firstIt, lastIt))
+  {
+    newOrder.resize(lastIt - firstIt + 1);
+    std::iota(newOrder.rbegin(), newOrder.rend(), 0);
+  }
+  CPNG reordered;
+  reordered.load_chunks_from_buffer(pFile, 8);
+  measures.push_back(measure("reorder_data_chunks", nbIterations, []{}, [&]{ reordered.reorder_data_chunks(newOrder); }));
+  measures.back().m_nbBytes = fileSize;
+  measures.back().m_nbChunks = newOrder.size();
+
+  // fix_all on a fresh load
+  measures.push_back(measure("fix_all", nbIterations,
+                             [&]{ pPNG = std::make_unique<CPNG>(); pPNG->load_chunks_from_buffer(pFile, 8); },
+                             [&]{ pPNG->fix_all(); }));
+  measures.back().m_nbBytes = fileSize;
+  measures.back().m_nbChunks = nbChunks;
+
+  // save_to_PNG of a mapped and reordered file, CRCs not verified yet
+  for (const auto mode:{CPNG::ESaveMode::EXTENTS, CPNG::ESaveMode::STREAM})
+  {
+    const bool isExtents = (mode == CPNG::ESaveMode::EXTENTS);
+    measures.push_back(measure(isExtents? "save_to_PNG_extents":"save_to_PNG_stream", nbIterations,
+                               [&]{ pPNG = std::make_unique<CPNG>(); pPNG->load_from_PNG(inName); pPNG->reorder_data_chunks(newOrder); },
+                               [&]{ pPNG->save_to_PNG(outName, mode); }));
+    measures.back().m_nbBytes = std::filesystem::file_size(outName);
+    measures.back().m_nbChunks = pPNG->get_nb_chunks();
+  }
+
+  std::filesystem::remove(outName);
+  if (inOptions.m_corpusDir.empty())
+  {
+    std::filesystem::remove(inName);
+  }
+  outFileSize = fileSize;
+  outNbChunks = nbChunks;
+  return measures;
+} // run_case
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+int main(int inArgC, char** inpArgV)
+{
+  int retVal = 0;
+  bool isSyntaxOk = true;
+  bool isListOnly = false;
+  SBenchOptions options;
+
+  for (int i = 1; isSyntaxOk && i < inArgC; i++)
+  {
+    const std::string arg = inpArgV[i];
+    const bool hasValue = (i + 1 < inArgC);
+    if (arg == "--iterations" && hasValue)
+    {
+      options.m_nbIterations = std::max<std::size_t>(std::stoul(inpArgV[++i]), 1);
+    }
+    else if (arg == "--scale" && hasValue)
+    {
+      options.m_scale = std::stod(inpArgV[++i]);
+    }
+    else if (arg == "--seed" && hasValue)
+    {
+      options.m_seed = std::stoull(inpArgV[++i]);
+    }
+    else if (arg == "--case" && hasValue)
+    {
+      options.m_cases.push_back(inpArgV[++i]);
+    }
+    else if (arg == "--label" && hasValue)
+    {
+      options.m_label = inpArgV[++i];
+    }
+    else if (arg == "--output" && hasValue)
+    {
+      options.m_outName = inpArgV[++i];
+    }
+    else if (arg == "--corpus" && hasValue)
+    {
+      options.m_corpusDir = inpArgV[++i];
+    }
+    else if (arg == "--list")
+    {
+      isListOnly = true;
+    }
+    else
+    {
+      isSyntaxOk = false;
+    }
+  }
+
+  const std::vector<SBenchCase> cases = get_cases(options);
+  if (!isSyntaxOk || cases.empty())
+  {
+    print_syntax(inpArgV[0]);
+    retVal = 1;
+  }
+  else if (isListOnly)
+  {
+    for (const auto& benchCase:cases)
+    {
+      std::cout<<benchCase.m_name<<std::endl;
+    }
+  }
+  else
+  {
+    std::filesystem::path dir = options.m_corpusDir.empty()? std::filesystem::temp_directory_path():std::filesystem::path(options.m_corpusDir);
+    std::filesystem::create_directories(dir);
+
+    std::ofstream outFile;
+    if (!options.m_outName.empty())
+    {
+      outFile.open(options.m_outName);
+    }
+    std::ostream& json = options.m_outName.empty()? std::cout:outFile;
+
+    json<<"{\n";
+    json<<"  \"label\": \""<<escape_json(options.m_label)<<"\",\n";
+    json<<"  \"crc32_kernel\": \""<<CCRC32::get_kernel_name(CCRC32::get_kernel())<<"\",\n";
+    json<<"  \"nb_threads\": "<<CThreadPool::get_default().get_nb_threads()<<",\n";
+    json<<"  \"iterations\": "<<options.m_nbIterations<<",\n";
+    json<<"  \"seed\": "<<options.m_seed<<",\n";
+    json<<"  \"cases\": [\n";
+    for (std::size_t c = 0; c < cases.size(); c++)
+    {
+      const SBenchCase& benchCase = cases[c];
+      std::size_t fileSize = 0;
+      std::size_t nbChunks = 0;
+      const std::vector<SMeasure> measures = run_case(benchCase, options, dir, fileSize, nbChunks);
+
+      json<<"    {\n";
+      json<<"      \"name\": \""<<benchCase.m_name<<"\",\n";
+      json<<"      \"file_size\": "<<fileSize<<",\n";
+      json<<"      \"nb_chunks\": "<<nbChunks<<",\n";
+      json<<"      \"nb_data_chunks\": "<<benchCase.m_options.m_nbDataChunks<<",\n";
+      json<<"      \"data_chunk_size\": "<<benchCase.m_options.m_dataChunkSize<<",\n";
+      json<<"      \"corruption\": \""<<CSyntheticPNG::get_corruption_name(benchCase.m_options.m_corruption)<<"\",\n";
+      json<<"      \"results\": {\n";
+      for (std::size_t m = 0; m < measures.size(); m++)
+      {
+        const SMeasure& result = measures[m];
+        const double mbPerSecond = result.m_bestNs > 0.? result.m_nbBytes * 1e3 / result.m_bestNs:0.;
+        const double nsPerChunk = result.m_nbChunks > 0? result.m_bestNs / result.m_nbChunks:0.;
+        json<<"        \""<<result.m_name<<"\": {\"best_ns\": "<<std::fixed<<std::setprecision(0)<<result.m_bestNs
+            <<", \"mean_ns\": "<<result.m_meanNs
+            <<", \"bytes\": "<<result.m_nbBytes
+            <<", \"chunks\": "<<result.m_nbChunks
+            <<", \"mb_per_s\": "<<std::setprecision(2)<<mbPerSecond
+            <<", \"ns_per_chunk\": "<<nsPerChunk<<"}"
+            <<(m + 1 < measures.size()? ",":"")<<"\n";
+      }
+      json<<"      }\n";
+      json<<"    }"<<(c + 1 < cases.size()? ",":"")<<"\n";
+    }
+    json<<"  ]\n";
+    json<<"}"<<std::endl;
+  }
+
+  return retVal;
+} // main
@@ -1,55 +1,436 @@
 #include "CPNG.h"
+#include "CCRC32.h"
+#include "CBatch.h"
+#include "CStreamReorderer.h"
 
+#include <charconv>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <filesystem>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static void print_syntax(const char* inpProgName)
+{
+  std::cout<<"Syntax: "<<inpProgName<<" [--stats[=json]] [--in-place[=journal|copy|direct]] pngFile \"New order\"|auto"<<std::endl;
+  std::cout<<"        "<<inpProgName<<" [--stats[=json]] [--in-place[=journal|copy|direct]] batch [--order \"New order\"|auto] [--clean] [--fix] [--recompress LEVEL [--deflate-block KB]] [--rechunk BYTES] [--verify] [--threads N] [--max-memory MB] [--max-chunk-size MB] [--max-file-size MB] [--max-process-memory MB] [--io[=uring|threads] [--queue-depth N]] [--suffix S] <dir|glob|@manifest|file>..."<<std::endl;
+  std::cout<<"        "<<inpProgName<<" [--stats[=json]] --stream [--max-memory MB] [--max-chunk-size MB] \"New order\" < in.png > out.png"<<std::endl;
+  std::cout<<"        "<<inpProgName<<" [--stats[=json]] --list pngFile"<<std::endl;
+  std::cout<<"        "<<inpProgName<<" [--stats[=json]] --verify pngFile"<<std::endl;
+  std::cout<<"        "<<inpProgName<<" --recover pngFile"<<std::endl;
+  std::cout<<"        "<<inpProgName<<" --crc-self-test"<<std::endl;
+  std::cout<<"Ex: "<<inpProgName<<" ./pngToReorder.png \"2 0 1 3\""<<std::endl;
+  std::cout<<"    "<<inpProgName<<" ./pngToReorder.png auto"<<std::endl;
+} // print_syntax
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// The whole of inpArg as a number of units of 2^inShift bytes (MB: 20), false
+// and a message on anything else or when the bytes do not fit.
+static bool parse_size(const std::string& inOption, const char* inpArg, const unsigned inShift, std::size_t& outValue)
+{
+  const char *pEnd = inpArg + std::strlen(inpArg);
+  std::size_t value = 0;
+  const auto result = std::from_chars(inpArg, pEnd, value);
+  const bool retVal = (result.ec == std::errc() && result.ptr == pEnd && pEnd != inpArg && value <= (SIZE_MAX >> inShift));
+  if (retVal)
+  {
+    outValue = value << inShift;
+  }
+  else
+  {
+    std::cout<<"Wrong value for "<<inOption<<": "<<inpArg<<std::endl;
+  }
+  return retVal;
+} // parse_size
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static std::vector<std::size_t> parse_order(const std::string& inOrder)
+{
+  std::vector<std::size_t> newOrder;
+  auto iss = std::istringstream{inOrder};
+  auto id = std::size_t{};
+  while (iss >> id)
+  {
+    newOrder.push_back(id);
+  }
+  return newOrder;
+} // parse_order
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Remove --stats or --stats=json from the arguments.
+static bool extract_stats_option(int& ioArgC, char** ioArgV, bool& outIsJSON)
+{
+  bool retVal = false;
+  int nbArgs = 1;
+  for (int i = 1; i < ioArgC; i++)
+  {
+    const std::string arg = ioArgV[i];
+    if (arg == "--stats" || arg == "--stats=json")
+    {
+      retVal = true;
+      outIsJSON = (arg == "--stats=json");
+    }
+    else
+    {
+      ioArgV[nbArgs++] = ioArgV[i];
+    }
+  }
+  ioArgC = nbArgs;
+  return retVal;
+} // extract_stats_option
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// Remove --in-place[=mode] from the arguments, journal by default.
+static bool extract_in_place_option(int& ioArgC, char** ioArgV, CInPlaceWriter::EMode& outMode, bool& ioIsSyntaxOk)
+{
+  bool retVal = false;
+  int nbArgs = 1;
+  outMode = CInPlaceWriter::EMode::JOURNAL;
+  const std::string option = "--in-place";
+  for (int i = 1; i < ioArgC; i++)
+  {
+    const std::string arg = ioArgV[i];
+    if (arg == option)
+    {
+      retVal = true;
+    }
+    else if (arg.compare(0, option.size() + 1, option + "=") == 0)
+    {
+      bool isOk = false;
+      outMode = CInPlaceWriter::get_mode(arg.substr(option.size() + 1), isOk);
+      ioIsSyntaxOk &= isOk;
+      retVal = true;
+    }
+    else
+    {
+      ioArgV[nbArgs++] = ioArgV[i];
+    }
+  }
+  ioArgC = nbArgs;
+  return retVal;
+} // extract_in_place_option
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// On stderr so that the normal output is unchanged.
+static void print_stats(const SStats& inStats, const bool inIsJSON)
+{
+#ifdef WITH_STATS
+  if (inIsJSON)
+  {
+    inStats.dump_json(std::cerr);
+  }
+  else
+  {
+    inStats.dump(std::cerr);
+  }
+#else
+  std::cerr<<"Stats not available, build with WITH_STATS"<<std::endl;
+#endif
+} // print_stats
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+static int run_batch(int inArgC, char** inpArgV, SStats* ioStats, const bool inIsInPlace, const CInPlaceWriter::EMode inInPlaceMode)
+{
+  int retVal = 1;
+  bool isSyntaxOk = true;
+  SBatchOptions options;
+  options.m_pStats = ioStats;
+  options.m_isInPlace = inIsInPlace;
+  options.m_inPlaceMode = inInPlaceMode;
+  std::vector<std::string> inputs;
+
+  for (int i = 2; isSyntaxOk && i < inArgC; i++)
+  {
+    const std::string arg = inpArgV[i];
+    const bool hasValue = (i + 1 < inArgC);
+    if (arg == "--order" && hasValue)
+    {
+      const std::string order = inpArgV[++i];
+      options.m_isAutoOrder = (order == "auto");
+      options.m_newOrder = options.m_isAutoOrder? std::vector<std::size_t>():parse_order(order);
+    }
+    else if (arg == "--clean")
+    {
+      options.m_clean = true;
+    }
+    else if (arg == "--fix")
+    {
+      options.m_fix = true;
+    }
+    else if (arg == "--recompress" && hasValue)
+    {
+      std::size_t level = 0;
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 0, level);
+      if (isSyntaxOk && level > 9)
+      {
+        std::cout<<"Wrong value for "<<arg<<": "<<level<<" (0-9)"<<std::endl;
+        isSyntaxOk = false;
+      }
+      options.m_recompressLevel = int(level);
+    }
+    else if (arg == "--deflate-block" && hasValue)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 10, options.m_deflateBlockSize);
+    }
+    else if (arg == "--verify")
+    {
+      options.m_verify = true;
+    }
+    else if (arg == "--rechunk" && hasValue)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 0, options.m_rechunkSize);
+    }
+    else if (arg == "--threads" && hasValue)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 0, options.m_nbThreads);
+    }
+    else if (arg == "--max-memory" && hasValue)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 20, options.m_maxInFlightBytes);
+    }
+    else if (arg == "--max-chunk-size" && hasValue)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 20, options.m_maxChunkSize);
+    }
+    else if (arg == "--max-file-size" && hasValue)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 20, options.m_maxFileSize);
+    }
+    else if (arg == "--max-process-memory" && hasValue)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 20, options.m_maxProcessBytes);
+    }
+    else if (arg == "--suffix" && hasValue)
+    {
+      options.m_suffix = inpArgV[++i];
+    }
+    else if (arg == "--io" || arg.compare(0, 5, "--io=") == 0)
+    {
+      options.m_isAsyncIO = true;
+      options.m_ioBackend = CIOEngine::get_backend(arg.size() > 5? arg.substr(5):"auto", isSyntaxOk);
+    }
+    else if (arg == "--queue-depth" && hasValue)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 0, options.m_ioQueueDepth);
+    }
+    else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0)
+    {
+      std::cout<<"Unknown batch option: "<<arg<<std::endl;
+      isSyntaxOk = false;
+    }
+    else
+    {
+      inputs.push_back(arg);
+    }
+  }
+
+  if (isSyntaxOk && options.m_suffix.empty() && !inIsInPlace)
+  {
+    std::cout<<"An empty suffix overwrites the inputs, use --in-place"<<std::endl;
+    isSyntaxOk = false;
+  }
+
+  if (isSyntaxOk && !inputs.empty())
+  {
+    CBatch batch(options);
+    for (const auto& input:inputs)
+    {
+      if (batch.add_input(input) == 0)
+      {
+        std::cerr<<"No file found for: "<<input<<std::endl;
+      }
+    }
+    retVal = batch.run(std::cout)? 0:1;
+  }
+  else
+  {
+    print_syntax(inpArgV[0]);
+  }
+
+  return retVal;
+} // run_batch
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// stdin to stdout, messages on stderr only.
+static int run_stream(int inArgC, char** inpArgV, SStats* ioStats)
+{
+  int retVal = 1;
+  std::size_t maxBufferedBytes = 64ull << 20;
+  SMemoryLimits limits;
+  std::vector<std::size_t> newOrder;
+  bool isSyntaxOk = true;
+  int nbOrders = 0;
+  for (int i = 2; isSyntaxOk && i < inArgC; i++)
+  {
+    const std::string arg = inpArgV[i];
+    if (arg == "--max-memory" && i + 1 < inArgC)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 20, maxBufferedBytes);
+    }
+    else if (arg == "--max-chunk-size" && i + 1 < inArgC)
+    {
+      isSyntaxOk = parse_size(arg, inpArgV[++i], 20, limits.m_maxChunkSize);
+    }
+    else
+    {
+      newOrder = parse_order(arg);
+      isSyntaxOk = (++nbOrders == 1);
+    }
+  }
+
+  if (isSyntaxOk)
+  {
+    CStreamReorderer reorderer(newOrder, maxBufferedBytes);
+    reorderer.set_stats(ioStats);
+    reorderer.set_memory_limits(limits);
+    retVal = reorderer.run(STDIN_FILENO, STDOUT_FILENO)? 0:1;
+  }
+  else
+  {
+    print_syntax(inpArgV[0]);
+  }
+  return retVal;
+} // run_stream
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 int main(int inArgC, char** inpArgV)
 {
   int retVal = 1;
-  if (inArgC != 3)
+  bool isStatsJSON = false;
+  const bool isStats = extract_stats_option(inArgC, inpArgV, isStatsJSON);
+  SStats stats;
+  bool isSyntaxOk = true;
+  CInPlaceWriter::EMode inPlaceMode;
+  const bool isInPlace = extract_in_place_option(inArgC, inpArgV, inPlaceMode, isSyntaxOk);
+
+  if (!isSyntaxOk)
+  {
+    print_syntax(inpArgV[0]);
+  }
+  else if (inArgC == 2 && std::string(inpArgV[1]) == "--crc-self-test")
+  {
+    retVal = CCRC32::self_test(std::cout)? 0:1;
+  }
+  else if (inArgC >= 2 && std::string(inpArgV[1]) == "batch")
+  {
+    retVal = run_batch(inArgC, inpArgV, isStats? &stats:nullptr, isInPlace, inPlaceMode);
+  }
+  else if (inArgC >= 2 && std::string(inpArgV[1]) == "--stream")
+  {
+    retVal = run_stream(inArgC, inpArgV, isStats? &stats:nullptr);
+  }
+  else if (inArgC == 3 && std::string(inpArgV[1]) == "--list")
+  {
+    CPNG pngFile;
+    pngFile.set_stats(isStats? &stats:nullptr);
+    if (pngFile.load_lazily_from_PNG(inpArgV[2]))
+    {
+      pngFile.dump_header(std::cout);
+      pngFile.dump_chunk_table(std::cout);
+      retVal = 0;
+    }
+    else
+    {
+      std::cout<<"PNG NOT OK"<<std::endl;
+    }
+  }
+  else if (inArgC == 3 && std::string(inpArgV[1]) == "--verify")
+  {
+    CPNG pngFile;
+    pngFile.set_stats(isStats? &stats:nullptr);
+    if (pngFile.load_from_PNG(inpArgV[2]))
+    {
+      const std::size_t nbValidChunks = pngFile.verify_chunks();
+      const CPNG::SDataCheck check = pngFile.check_data_stream();
+      std::cout<<"Valid chunks: "<<nbValidChunks<<"/"<<pngFile.get_nb_chunks()<<std::endl;
+      std::cout<<"Data stream: "<<check.get_message()<<std::endl;
+      retVal = (nbValidChunks == pngFile.get_nb_chunks() && check.m_result == CPNG::SDataCheck::EResult::SOUND)? 0:1;
+    }
+    else
+    {
+      std::cout<<"PNG NOT OK"<<std::endl;
+    }
+  }
+  else if (inArgC == 3 && std::string(inpArgV[1]) == "--recover")
+  {
+    if (CInPlaceWriter::recover(inpArgV[2]))
+    {
+      std::cout<<"No interrupted rewrite left on: "<<inpArgV[2]<<std::endl;
+      retVal = 0;
+    }
+  }
+  else if (inArgC != 3)
   {
-    std::cout<<"Syntax: "<<inpArgV[0]<<" pngFile \"New order\""<<std::endl;
-    std::cout<<"Ex: "<<inpArgV[0]<<" ./pngToReorder.png \"2 0 1 3\""<<std::endl;
+    print_syntax(inpArgV[0]);
   }
   else
   {
     std::filesystem::path imgFile(inpArgV[1]);
     CPNG pngFile;
+    pngFile.set_stats(isStats? &stats:nullptr);
     if (pngFile.load_from_PNG(imgFile))
     {
       std::cout<<"After load"<<std::endl;
       pngFile.dump_chunks(std::cout);
 
       std::vector<std::size_t> newOrder;
-      auto iss = std::istringstream{inpArgV[2]};
-      auto id = std::size_t{};
-      while (iss >> id)
+      bool isOrderFound = true;
+      if (std::string(inpArgV[2]) == "auto")
       {
-        newOrder.push_back(id);
+        isOrderFound = pngFile.find_data_order(newOrder);
       }
-      
+      else
+      {
+        newOrder = parse_order(inpArgV[2]);
+      }
+
       std::cout<<"New order: ";
       for (auto val:newOrder) {std::cout<<val<<" ";}
       std::cout<<std::endl;
 
-      pngFile.reorder_data_chunks(newOrder);
-     
-      std::cout<<"After reorder"<<std::endl;
-      pngFile.dump_chunks(std::cout); 
-
-      std::filesystem::path outFile((imgFile.parent_path().string().empty()? "":imgFile.parent_path().string()+"/")+imgFile.stem().string()+"_reordered"+imgFile.extension().string());
-
-      if (pngFile.save_to_PNG(outFile))
+      // an empty order would leave the chunks as they are
+      if (!isOrderFound || !pngFile.reorder_data_chunks(newOrder))
       {
-        std::cout<<"Reordered png saved in: "<<outFile<<std::endl;
-        retVal = 0;
+        std::cout<<"Cannot reorder, nothing saved"<<std::endl;
       }
       else
       {
-        std::cout<<"Cannot save: '"<<outFile<<"'"<<std::endl;
+        std::cout<<"After reorder"<<std::endl;
+        pngFile.dump_chunks(std::cout); 
+
+        std::filesystem::path outFile(CBatch::get_output_name(imgFile.string(), "_reordered"));
+
+        if (isInPlace)
+        {
+          if (pngFile.save_in_place(imgFile, inPlaceMode))
+          {
+            std::cout<<"Reordered png rewritten in place: "<<imgFile<<std::endl;
+            retVal = 0;
+          }
+          else
+          {
+            std::cout<<"Cannot rewrite in place: "<<imgFile<<std::endl;
+          }
+        }
+        else if (pngFile.save_to_PNG(outFile))
+        {
+          std::cout<<"Reordered png saved in: "<<outFile<<std::endl;
+          retVal = 0;
+        }
+        else
+        {
+          std::cout<<"Cannot save: '"<<outFile<<"'"<<std::endl;
+        }
       }
     }
     else
@@ -57,6 +438,11 @@ int main(int inArgC, char** inpArgV)
       std::cout<<"PNG NOT OK"<<std::endl;
     }
   }
+
+  if (isStats)
+  {
+    print_stats(stats, isStatsJSON);
+  }
   
   return retVal;
 } // main